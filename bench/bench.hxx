@@ -0,0 +1,147 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+#pragma once
+
+#include "counters.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace varbor::bench {
+/** Keep the compiler from discarding a result that is never otherwise used.
+ */
+template <typename T>
+inline void do_not_optimize(const T &value) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void *sink;
+    sink = &value;
+#endif
+}
+
+struct Result {
+    std::string name;
+    std::size_t iterations = 0;
+    double nanoseconds = 0.0;
+
+    // Counter totals over the same batch as nanoseconds.
+    std::vector<std::pair<std::string, double>> counters;
+
+    // Input bytes and items handled by one iteration, if the caller sets them.
+    std::size_t bytes = 0;
+    std::size_t items = 0;
+
+    inline double per_iteration() const noexcept {
+        return nanoseconds / static_cast<double>(iterations);
+    }
+
+    inline double per_iteration(const double total) const noexcept {
+        return total / static_cast<double>(iterations);
+    }
+};
+
+/** Run f in batches, doubling the batch size until one batch takes at least
+ * min_time, then time that batch size repeatedly and keep the fastest, which
+ * is the least disturbed by the rest of the machine.  With counters, they are
+ * read around each repeated batch, and those of the fastest are kept.
+ */
+template <typename F>
+inline Result run(
+  std::string name,
+  F &&f,
+  Counters *const counters = nullptr,
+  const std::chrono::nanoseconds min_time = std::chrono::milliseconds(100),
+  const std::size_t repetitions = 7) {
+    using Clock = std::chrono::steady_clock;
+    const auto batch = [&f](const std::size_t iterations) {
+        const auto start = Clock::now();
+        for (std::size_t i = 0; i < iterations; ++i) {
+            f();
+        }
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start);
+    };
+
+    std::size_t iterations = 1;
+    auto fastest = batch(iterations);
+    while (fastest < min_time) {
+        iterations *= 2;
+        fastest = batch(iterations);
+    }
+    Result result;
+    result.name = std::move(name);
+    result.iterations = iterations;
+    result.nanoseconds = static_cast<double>(fastest.count());
+    // The calibrating batch ran without counters, so it cannot be kept when
+    // they are wanted.
+    for (std::size_t i = counters ? 0 : 1; i < repetitions; ++i) {
+        if (counters) {
+            counters->start();
+        }
+        const auto time = batch(iterations);
+        auto counts = counters ? counters->stop() : decltype(result.counters){};
+        if (i == 0 || time < fastest) {
+            fastest = time;
+            result.nanoseconds = static_cast<double>(fastest.count());
+            result.counters = std::move(counts);
+        }
+    }
+    return result;
+}
+
+inline void report(const Result &result) {
+    std::printf(
+      "%-32s %12.1f ns/op %12zu iterations\n",
+      result.name.c_str(),
+      result.per_iteration(),
+      result.iterations);
+    for (const auto &[name, total] : result.counters) {
+        const auto per_op = result.per_iteration(total);
+        std::printf("    %-28s %12.1f /op", name.c_str(), per_op);
+        if (result.bytes) {
+            std::printf(" %10.3f /byte", per_op / static_cast<double>(result.bytes));
+        }
+        if (result.items) {
+            std::printf(" %10.3f /item", per_op / static_cast<double>(result.items));
+        }
+        std::printf("\n");
+    }
+}
+
+/** Write result as one line of JSON, with every count per iteration, so runs
+ * can be kept and diffed over time.
+ */
+inline void write_json(std::FILE *const output, const Result &result) {
+    std::fprintf(output, "{\"name\":\"");
+    for (const auto c : result.name) {
+        if (c == '"' || c == '\\') {
+            std::fputc('\\', output);
+        }
+        std::fputc(c, output);
+    }
+    std::fprintf(
+      output,
+      "\",\"iterations\":%zu,\"nanoseconds\":%.3f,\"bytes\":%zu,\"items\":%zu,\"counters\":{",
+      result.iterations,
+      result.per_iteration(),
+      result.bytes,
+      result.items);
+    const char *separator = "";
+    for (const auto &[name, total] : result.counters) {
+        std::fprintf(
+          output,
+          "%s\"%s\":%.3f",
+          separator,
+          name.c_str(),
+          result.per_iteration(total));
+        separator = ",";
+    }
+    std::fprintf(output, "}}\n");
+}
+} // namespace varbor::bench
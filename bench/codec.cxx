@@ -0,0 +1,139 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+
+#include "bench.hxx"
+
+#include <varbor.hxx>
+#include <varbor/instrument.hxx>
+#include <varbor/io.hxx>
+
+#include <cstring>
+#include <optional>
+
+// A record shaped like a typical RPC payload: a map of scalars, strings,
+// byte strings and a nested array of small maps.
+static varbor::Value document() {
+    varbor::Array items;
+    for (int i = 0; i < 64; ++i) {
+        varbor::Map item;
+        item.value.emplace(
+          std::make_unique<varbor::Value>(u8"id"),
+          std::make_unique<varbor::Value>(i * 1000));
+        item.value.emplace(
+          std::make_unique<varbor::Value>(u8"score"),
+          std::make_unique<varbor::Value>(i * 0.37));
+        item.value.emplace(
+          std::make_unique<varbor::Value>(u8"name"),
+          std::make_unique<varbor::Value>(u8"item name of moderate length"));
+        item.value.emplace(
+          std::make_unique<varbor::Value>(u8"delta"),
+          std::make_unique<varbor::Value>(-i));
+        item.value.emplace(
+          std::make_unique<varbor::Value>(u8"flag"),
+          std::make_unique<varbor::Value>(i % 2 == 0));
+        items.value.push_back(std::make_unique<varbor::Value>(std::move(item)));
+    }
+    varbor::Map root;
+    root.value.emplace(
+      std::make_unique<varbor::Value>(u8"items"),
+      std::make_unique<varbor::Value>(std::move(items)));
+    root.value.emplace(
+      std::make_unique<varbor::Value>(u8"blob"),
+      std::make_unique<varbor::Value>(std::vector<std::byte>(256, std::byte(7))));
+    root.value.emplace(
+      std::make_unique<varbor::Value>(u8"version"),
+      std::make_unique<varbor::Value>(3));
+    return varbor::Value(std::move(root));
+}
+
+struct Counted : varbor::DecodePolicy {
+    using instrument = varbor::Instrumented;
+};
+
+// Usage: bench_codec [--counters] [--json FILE]
+//
+// --counters reads perf_event_open counters around each case, where the
+// machine allows it, and --json appends one JSON record per case to FILE.
+int main(const int argc, char **const argv) {
+    using namespace varbor::bench;
+
+    std::optional<Counters> counters;
+    std::FILE *json = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--counters") == 0) {
+            counters.emplace();
+            if (!counters->available()) {
+                std::fprintf(stderr, "No performance counters available, timing only\n");
+                counters.reset();
+            }
+        } else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json = std::fopen(argv[++i], "a");
+            if (!json) {
+                std::perror(argv[i]);
+                return 1;
+            }
+        } else {
+            std::fprintf(stderr, "Usage: %s [--counters] [--json FILE]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    const auto value = document();
+    const auto encoded = value.encode();
+    const auto copy = varbor::Value::decode(encoded);
+    varbor::Instrumented::take();
+    varbor::Value::decode<Counted>(encoded);
+    const auto items = varbor::Instrumented::take().total_nodes();
+
+    // Every case handles the whole document once per iteration.
+    const auto measure = [&](std::string name, auto &&f) {
+        auto result = run(std::move(name), f, counters ? &*counters : nullptr);
+        result.bytes = encoded.size();
+        result.items = items;
+        report(result);
+        if (json) {
+            write_json(json, result);
+        }
+    };
+
+    measure("encode", [&] {
+        do_not_optimize(value.encode());
+    });
+    measure("encode back_inserter", [&] {
+        std::vector<std::byte> output;
+        output.reserve(encoded.size());
+        value.encode(std::back_inserter(output));
+        do_not_optimize(output.data());
+    });
+    measure("encoded_size", [&] {
+        do_not_optimize(value.encoded_size());
+    });
+    measure("compare equal", [&] {
+        do_not_optimize(value == copy);
+    });
+    measure("order equal", [&] {
+        do_not_optimize(value <=> copy);
+    });
+    measure("decode", [&] {
+        do_not_optimize(varbor::Value::decode(encoded));
+    });
+    measure("decode ByteSource", [&] {
+        varbor::SpanSource source(encoded);
+        do_not_optimize(varbor::decode(source));
+    });
+    measure("encode ByteSink", [&] {
+        std::vector<std::byte> output;
+        output.reserve(encoded.size());
+        varbor::VectorSink sink(output);
+        varbor::encode(value, sink);
+        do_not_optimize(output.data());
+    });
+    measure("skip", [&] {
+        do_not_optimize(varbor::skip(encoded.begin(), encoded.end()));
+    });
+    if (json) {
+        std::fclose(json);
+    }
+    return 0;
+}
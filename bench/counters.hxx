@@ -0,0 +1,119 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace varbor::bench {
+/** Hardware and software performance counters for the calling thread, read
+ * through perf_event_open.  Each counter is opened on its own, so one the
+ * kernel or the machine does not offer is left out rather than taking the
+ * others with it.  Off Linux there are none.
+ */
+class Counters {
+  private:
+    struct Event {
+        const char *name;
+        int fd;
+    };
+
+    std::vector<Event> events_;
+
+  public:
+    inline Counters() {
+#if defined(__linux__)
+        constexpr auto cache = [](const std::uint64_t level) {
+            return level | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        };
+        const struct {
+            const char *name;
+            std::uint32_t type;
+            std::uint64_t config;
+        } wanted[] = {
+          {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+          {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+          {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+          {"l1d-misses", PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_L1D)},
+          {"llc-misses", PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_LL)},
+          {"page-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+        };
+        for (const auto &event : wanted) {
+            perf_event_attr attr{};
+            attr.size = sizeof(attr);
+            attr.type = event.type;
+            attr.config = event.config;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            const auto fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            if (fd >= 0) {
+                events_.push_back(Event{event.name, fd});
+            }
+        }
+#endif
+    }
+
+    Counters(const Counters &) = delete;
+    Counters &operator=(const Counters &) = delete;
+
+    inline ~Counters() {
+#if defined(__linux__)
+        for (const auto &event : events_) {
+            close(event.fd);
+        }
+#endif
+    }
+
+    /** Whether any counter could be opened.
+     */
+    inline bool available() const noexcept {
+        return !events_.empty();
+    }
+
+    /** Zero and start every counter.
+     */
+    inline void start() noexcept {
+#if defined(__linux__)
+        for (const auto &event : events_) {
+            ioctl(event.fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(event.fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    /** Stop every counter and return the counts since start(), scaled up if
+     * the kernel had to multiplex them.
+     */
+    inline std::vector<std::pair<std::string, double>> stop() {
+        std::vector<std::pair<std::string, double>> output;
+#if defined(__linux__)
+        for (const auto &event : events_) {
+            ioctl(event.fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+        for (const auto &event : events_) {
+            // value, time enabled, time running
+            std::uint64_t values[3] = {};
+            if (read(event.fd, values, sizeof(values)) != sizeof(values) || values[2] == 0) {
+                continue;
+            }
+            const auto scale = static_cast<double>(values[1]) / static_cast<double>(values[2]);
+            output.emplace_back(event.name, static_cast<double>(values[0]) * scale);
+        }
+#endif
+        return output;
+    }
+};
+} // namespace varbor::bench
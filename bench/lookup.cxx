@@ -0,0 +1,51 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+
+#include "bench.hxx"
+
+#include <varbor.hxx>
+#include <varbor/frozen.hxx>
+
+// A static lookup table of string keys, queried for every key in turn.
+static varbor::Map table(const std::size_t size) {
+    varbor::Map map;
+    for (std::size_t i = 0; i < size; ++i) {
+        map.value.emplace(
+          std::make_unique<varbor::Value>(u8"config.entry." + std::u8string(
+            reinterpret_cast<const char8_t *>(std::to_string(i).c_str()))),
+          std::make_unique<varbor::Value>(i));
+    }
+    return map;
+}
+
+int main() {
+    using namespace varbor::bench;
+
+    for (const std::size_t size : {16, 1024, 65536}) {
+        const auto map = table(size);
+        const auto frozen = varbor::freeze(table(size));
+        std::vector<varbor::Value> keys;
+        std::vector<std::vector<std::byte>> encoded_keys;
+        for (const auto &[key, value] : map.value) {
+            keys.push_back(varbor::Value::decode(key->encode()));
+            encoded_keys.push_back(key->encode());
+        }
+
+        const auto suffix = " " + std::to_string(size);
+        std::size_t i = 0;
+        report(run("Map find" + suffix, [&] {
+            do_not_optimize(map.value.find(keys[i]));
+            i = (i + 1) % size;
+        }));
+        report(run("FrozenMap find" + suffix, [&] {
+            do_not_optimize(frozen.find(keys[i]));
+            i = (i + 1) % size;
+        }));
+        report(run("FrozenMap find encoded" + suffix, [&] {
+            do_not_optimize(frozen.find_encoded(encoded_keys[i]));
+            i = (i + 1) % size;
+        }));
+    }
+    return 0;
+}
@@ -0,0 +1,55 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+
+// libFuzzer harness for decoding.  Besides crashes, it keeps the slowest
+// input found so far in the file named by VARBOR_FUZZ_SLOWEST, or
+// slowest.cbor, so expensive inputs can be added to test/complexity.cxx.  Run
+// it with -max_len to compare inputs of a bounded size.
+
+#include <varbor.hxx>
+#include <varbor/tags.hxx>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+struct Policy : varbor::DecodePolicy {
+    using tags = varbor::StandardTags;
+    static constexpr std::size_t max_depth = 256;
+};
+
+void record(const std::uint8_t *data, const std::size_t size, const double nanoseconds) {
+    static double slowest = 0;
+    if (nanoseconds <= slowest) {
+        return;
+    }
+    slowest = nanoseconds;
+    const char *path = std::getenv("VARBOR_FUZZ_SLOWEST");
+    if (!path) {
+        path = "slowest.cbor";
+    }
+    if (const auto file = std::fopen(path, "wb")) {
+        std::fwrite(data, 1, size, file);
+        std::fclose(file);
+    }
+    std::fprintf(stderr, "slowest input: %zu bytes, %.0f ns\n", size, nanoseconds);
+}
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data, const std::size_t size) {
+    const std::span<const std::byte> input(reinterpret_cast<const std::byte *>(data), size);
+    const auto start = std::chrono::steady_clock::now();
+    try {
+        // Compared encoded, because NaN is not equal to itself
+        const auto encoded = varbor::Value::decode<Policy>(input).encode();
+        if (varbor::Value::decode<Policy>(encoded).encode() != encoded) {
+            std::abort();
+        }
+    } catch (const varbor::Error &) {
+    }
+    const std::chrono::duration<double, std::nano> time = std::chrono::steady_clock::now() - start;
+    record(data, size, time.count());
+    return 0;
+}
@@ -0,0 +1,137 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+module;
+
+#include <varbor.hxx>
+#include <varbor/concurrent.hxx>
+#include <varbor/frozen.hxx>
+#include <varbor/instrument.hxx>
+#include <varbor/io.hxx>
+#include <varbor/parallel.hxx>
+#include <varbor/patch.hxx>
+#include <varbor/persistent.hxx>
+#include <varbor/profile.hxx>
+#include <varbor/tags.hxx>
+#include <varbor/walk.hxx>
+
+export module varbor;
+
+export namespace varbor {
+// Errors
+using varbor::DuplicateKey;
+using varbor::EndOfInput;
+using varbor::Error;
+using varbor::IllegalSpecialFloat;
+using varbor::InvalidType;
+using varbor::InvalidUtf8;
+using varbor::PolicyError;
+using varbor::SpecialCountError;
+
+// Headers and raw encoding
+using varbor::ComparingIterator;
+using varbor::Count;
+using varbor::CountingIterator;
+using varbor::from_be_bytes;
+using varbor::HashingIterator;
+using varbor::Header;
+using varbor::lossless_float16;
+using varbor::MajorType;
+using varbor::read;
+using varbor::read_float16;
+using varbor::read_header;
+using varbor::skip;
+using varbor::skip_body;
+using varbor::skip_bytes;
+using varbor::to_be_bytes;
+using varbor::write_header;
+using varbor::write_integer;
+
+// Values
+using varbor::Array;
+using varbor::BigNum;
+using varbor::Boolean;
+using varbor::Break;
+using varbor::ByteString;
+using varbor::DateTime;
+using varbor::DecimalFraction;
+using varbor::EmbeddedCbor;
+using varbor::Float;
+using varbor::IntMap;
+using varbor::Map;
+using varbor::Negative;
+using varbor::Null;
+using varbor::OrderedMap;
+using varbor::Positive;
+using varbor::SemanticTag;
+using varbor::SharedBuffer;
+using varbor::Undefined;
+using varbor::Utf8String;
+using varbor::Uuid;
+using varbor::Value;
+using varbor::ValuePointer;
+using varbor::Variant;
+
+// Decoding
+using varbor::BigNumTag;
+using varbor::DateTimeTag;
+using varbor::DecimalFractionTag;
+using varbor::Decoder;
+using varbor::DecodePolicy;
+using varbor::DuplicateKeys;
+using varbor::EmbeddedCborTag;
+using varbor::StandardTags;
+using varbor::TagRegistry;
+using varbor::UuidTag;
+
+// Instrumentation
+using varbor::Instrumented;
+using varbor::NoInstrument;
+using varbor::Statistics;
+
+// varbor/concurrent.hxx
+using varbor::ConcurrentMap;
+
+// varbor/frozen.hxx
+using varbor::freeze;
+using varbor::FrozenMap;
+
+// varbor/io.hxx
+using varbor::ByteSink;
+using varbor::ByteSource;
+using varbor::decode;
+using varbor::encode;
+using varbor::SpanSource;
+using varbor::StreamSink;
+using varbor::StreamSource;
+using varbor::VectorSink;
+
+// varbor/parallel.hxx
+using varbor::parallel_reduce;
+using varbor::parallel_stable_sort;
+using varbor::ParallelDecodePolicy;
+
+// varbor/patch.hxx
+using varbor::Extent;
+using varbor::locate;
+using varbor::patch;
+using varbor::patch_in_place;
+using varbor::PathStep;
+using varbor::splice;
+
+// varbor/persistent.hxx
+using varbor::PersistentArray;
+using varbor::PersistentMap;
+
+// varbor/profile.hxx
+using varbor::PathProfile;
+using varbor::Profile;
+using varbor::profile_decode;
+
+// varbor/walk.hxx
+using varbor::BasicCursor;
+using varbor::Cursor;
+using varbor::CursorEvent;
+using varbor::MutableCursor;
+using varbor::Step;
+} // namespace varbor
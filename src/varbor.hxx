@@ -6,26 +6,24 @@
 #include <algorithm>
 #include <array>
 #include <bit>
-#include <bitset>
 #include <cmath>
 #include <compare>
 #include <concepts>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
-#include <iostream>
 #include <iterator>
 #include <limits>
 #include <map>
 #include <memory>
 #include <optional>
-#include <ranges>
 #include <span>
 #include <stdexcept>
 #include <string>
 #include <string_view>
 #include <tuple>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <variant>
 #include <vector>
@@ -36,7 +34,16 @@
 #define VARBOR_UNREACHABLE __builtin_unreachable()
 #endif
 
+#ifdef __SIZEOF_INT128__
+#define VARBOR_HAS_INT128 1
+#endif
+
 namespace varbor {
+#ifdef VARBOR_HAS_INT128
+__extension__ typedef __int128 Int128;
+__extension__ typedef unsigned __int128 UInt128;
+#endif
+
 /** Default error type.
  */
 class Error : public std::runtime_error {
@@ -85,6 +92,36 @@ class SpecialCountError : public Error {
     }
 };
 
+/** The input used something the decode policy does not allow.
+ */
+class PolicyError : public Error {
+  public:
+    template <class... Args>
+        requires std::constructible_from<Error, Args...>
+    PolicyError(Args &&...t) : Error(std::forward<Args>(t)...) {
+    }
+};
+
+/** A text string was not valid UTF-8.
+ */
+class InvalidUtf8 : public Error {
+  public:
+    template <class... Args>
+        requires std::constructible_from<Error, Args...>
+    InvalidUtf8(Args &&...t) : Error(std::forward<Args>(t)...) {
+    }
+};
+
+/** A map contained the same key twice and the decode policy rejects that.
+ */
+class DuplicateKey : public Error {
+  public:
+    template <class... Args>
+        requires std::constructible_from<Error, Args...>
+    DuplicateKey(Args &&...t) : Error(std::forward<Args>(t)...) {
+    }
+};
+
 /** The major type read from the header.
  */
 enum class MajorType {
@@ -98,75 +135,56 @@ enum class MajorType {
     SpecialFloat = 7
 };
 
-template <typename T>
-inline T from_be_bytes(std::array<std::byte, sizeof(T)> input) {
-    T value;
-    const auto v_pointer = reinterpret_cast<std::byte *>(&value);
-
-    for (size_t i = 0; i < sizeof(value); ++i) {
-        if constexpr (std::endian::native == std::endian::big) {
-            v_pointer[i] = input[i];
-        } else {
-            v_pointer[i] = input[sizeof(value) - 1 - i];
-        }
-    }
-
-    return value;
-}
-
-inline float read_float16(std::array<std::byte, 2> input) {
-    const bool sign = (input[0] & std::byte(0b10000000)) != std::byte(0);
-    const std::uint8_t exponent =
-      static_cast<std::uint8_t>((input[0] & std::byte(0b01111100)) >> 2);
-    const std::uint16_t fraction =
-      (static_cast<std::uint16_t>(input[0] & std::byte(0b00000011)) << 8) |
-      static_cast<std::uint16_t>(input[1]);
-    if (exponent == 0) {
-        // zero
-        if (fraction == 0) {
-            if (sign) {
-                return -0.0f;
-            } else {
-                return 0.0f;
-            }
-        } else {
-            // Subnormal.  There probably is a better way of doing this.
-            const auto adjusted_fraction =
-              static_cast<float>(fraction) / static_cast<float>(1 << 10);
-            return (sign ? -1.0f : 1.0f) * adjusted_fraction * std::pow(2.0f, -14);
-        }
-    } else if (exponent == 0b11111) {
-        // infinity
-        if (fraction == 0) {
-            return (sign ? -1.0f : 1.0f) * std::numeric_limits<float>::infinity();
-        } else {
-            // NaN
-            return std::numeric_limits<float>::quiet_NaN();
-        }
-    } else {
-        const std::int8_t normalized_exponent = static_cast<std::int8_t>(exponent) - 15;
-        const auto biased_exponent =
-          std::byte(static_cast<std::int16_t>(normalized_exponent) + 127);
-
-        std::array<std::byte, 4> bytes = {std::byte(0), std::byte(0), std::byte(0), std::byte(0)};
-
-        if (sign) {
-            bytes[0] = std::byte(0b10000000);
+namespace detail {
+/** Call f with the active alternative of variant, dispatching with a plain
+ * switch on its index.  Unlike std::visit, which goes through a table of
+ * function pointers for larger variants, every case can be inlined.
+ */
+template <typename Variant, typename F>
+inline decltype(auto) visit(Variant &&variant, F &&f) {
+    constexpr auto size = std::variant_size_v<std::remove_cvref_t<Variant>>;
+    static_assert(size <= 24, "detail::visit handles at most 24 alternatives");
+
+#define VARBOR_VISIT_CASE(N)                                                                       \
+    case N:                                                                                        \
+        if constexpr (N < size) {                                                                  \
+            return f(*std::get_if<N>(&variant));                                                   \
+        } else {                                                                                   \
+            VARBOR_UNREACHABLE;                                                                    \
         }
-        bytes[0] |= biased_exponent >> 1;
-
-        // Left bit is right bit from exponent.
-        bytes[1] = biased_exponent << 7;
-
-        // Most significant 7 bits from 10-bit fraction
-        bytes[1] |= std::byte(fraction >> 3);
-
-        // Least significant 3 bits of 10-bit fraction
-        bytes[2] = std::byte(fraction << 5);
 
-        return from_be_bytes<float>(bytes);
-    }
+    switch (variant.index()) {
+        VARBOR_VISIT_CASE(0)
+        VARBOR_VISIT_CASE(1)
+        VARBOR_VISIT_CASE(2)
+        VARBOR_VISIT_CASE(3)
+        VARBOR_VISIT_CASE(4)
+        VARBOR_VISIT_CASE(5)
+        VARBOR_VISIT_CASE(6)
+        VARBOR_VISIT_CASE(7)
+        VARBOR_VISIT_CASE(8)
+        VARBOR_VISIT_CASE(9)
+        VARBOR_VISIT_CASE(10)
+        VARBOR_VISIT_CASE(11)
+        VARBOR_VISIT_CASE(12)
+        VARBOR_VISIT_CASE(13)
+        VARBOR_VISIT_CASE(14)
+        VARBOR_VISIT_CASE(15)
+        VARBOR_VISIT_CASE(16)
+        VARBOR_VISIT_CASE(17)
+        VARBOR_VISIT_CASE(18)
+        VARBOR_VISIT_CASE(19)
+        VARBOR_VISIT_CASE(20)
+        VARBOR_VISIT_CASE(21)
+        VARBOR_VISIT_CASE(22)
+        VARBOR_VISIT_CASE(23)
+    default:
+        VARBOR_UNREACHABLE;
+    }
+
+#undef VARBOR_VISIT_CASE
 }
+} // namespace detail
 
 /** The count read from the header.  If the count is 24-27, the extended count
  * field is delivered in one of the last four variants, otherwise, it is simply
@@ -222,7 +240,7 @@ struct Header {
      */
     inline std::optional<std::uint64_t> get_count() const {
         if (count.index() == 0) {
-            const auto tinycount = std::get<0>(count);
+            const auto tinycount = *std::get_if<0>(&count);
             if (tinycount < 24) {
                 return tinycount;
             } else if (tinycount == 31) {
@@ -230,70 +248,30 @@ struct Header {
             } else {
                 throw SpecialCountError("Tiny count would be ambiguous");
             }
-        } else {
-            return std::visit(
-              [](const auto element) {
-                  return static_cast<std::uint64_t>(element);
-              },
-              count);
-        }
-    }
-};
-
-/** Read a single byte, returning an error if input is empty.
- */
-template <typename InputIt>
-inline std::tuple<InputIt, std::byte> read(InputIt begin, const InputIt end) {
-    if (begin == end) {
-        throw EndOfInput("Reached end of input early");
-    }
-    const std::byte output = *begin;
-    ++begin;
-    return {begin, output};
-}
-
-template <typename InputIt>
-std::tuple<InputIt, Header> read_header(InputIt begin, const InputIt end) {
-    std::byte byte;
-    std::tie(begin, byte) = read(begin, end);
-    const auto type = static_cast<MajorType>(byte >> 5);
-    const auto tinycount = static_cast<std::uint8_t>(byte & std::byte(0b00011111));
-
-    switch (tinycount) {
-    case 24: {
-        std::tie(begin, byte) = read(begin, end);
-        return {begin, Header{type, Count(std::in_place_index<1>, static_cast<uint8_t>(byte))}};
-    }
-
-    case 25: {
-        std::array<std::byte, 2> count;
-        for (size_t i = 0; i < sizeof(count); ++i) {
-            std::tie(begin, count[i]) = read(begin, end);
         }
-        return {begin, Header{type, Count(std::in_place_index<2>, from_be_bytes<uint16_t>(count))}};
-    }
-
-    case 26: {
-        std::array<std::byte, 4> count;
-        for (size_t i = 0; i < sizeof(count); ++i) {
-            std::tie(begin, count[i]) = read(begin, end);
+        switch (count.index()) {
+        case 1:
+            return *std::get_if<1>(&count);
+        case 2:
+            return *std::get_if<2>(&count);
+        case 3:
+            return *std::get_if<3>(&count);
+        default:
+            return *std::get_if<4>(&count);
         }
-        return {begin, Header{type, Count(std::in_place_index<3>, from_be_bytes<uint32_t>(count))}};
     }
 
-    case 27: {
-        std::array<std::byte, 8> count;
-        for (size_t i = 0; i < sizeof(count); ++i) {
-            std::tie(begin, count[i]) = read(begin, end);
+    /** Like get_count, but for items that cannot be indefinite, throwing a
+     * SpecialCountError if the count is.
+     */
+    inline std::uint64_t get_definite_count() const {
+        const auto definite = get_count();
+        if (!definite) {
+            throw SpecialCountError("Indefinite count on an item that must be definite");
         }
-        return {begin, Header{type, Count(std::in_place_index<4>, from_be_bytes<uint64_t>(count))}};
-    }
-
-    default: {
-        return {begin, Header{type, Count(std::in_place_index<0>, tinycount)}};
-    }
+        return *definite;
     }
-}
+};
 
 template <typename T>
 inline std::array<std::byte, sizeof(T)> to_be_bytes(const T &value) {
@@ -320,20 +298,200 @@ OutputIt write_header(OutputIt output, const Header header) {
     const auto type_byte = std::byte(static_cast<std::uint8_t>(type) << 5);
 
     if (count.index() == 0) {
-        *output = (type_byte | std::byte(std::get<0>(count)));
+        *output = (type_byte | std::byte(*std::get_if<0>(&count)));
         return ++output;
     } else {
         *output = (type_byte | std::byte(23 + count.index()));
         ++output;
 
-        return std::visit(
-          [&](const auto &count) {
-              return std::ranges::copy(to_be_bytes(count), output).out;
-          },
-          count);
+        switch (count.index()) {
+        case 1:
+            return std::ranges::copy(to_be_bytes(*std::get_if<1>(&count)), output).out;
+        case 2:
+            return std::ranges::copy(to_be_bytes(*std::get_if<2>(&count)), output).out;
+        case 3:
+            return std::ranges::copy(to_be_bytes(*std::get_if<3>(&count)), output).out;
+        default:
+            return std::ranges::copy(to_be_bytes(*std::get_if<4>(&count)), output).out;
+        }
+    }
+}
+
+/** Write the shortest header for a plain count, without building a Header.
+ * Every definite-length item goes through here when encoding.
+ */
+template <typename OutputIt>
+OutputIt write_header(OutputIt output, const MajorType type, const std::uint64_t count) {
+    const auto type_byte = static_cast<std::uint8_t>(static_cast<std::uint8_t>(type) << 5);
+    if (count < 24) {
+        *output = std::byte(type_byte | static_cast<std::uint8_t>(count));
+        return ++output;
+    }
+
+    std::size_t width;
+    std::uint8_t tiny;
+    if (count < 0x100ull) {
+        width = 1;
+        tiny = 24;
+    } else if (count < 0x10000ull) {
+        width = 2;
+        tiny = 25;
+    } else if (count < 0x100000000ull) {
+        width = 4;
+        tiny = 26;
+    } else {
+        width = 8;
+        tiny = 27;
+    }
+    *output = std::byte(type_byte | tiny);
+    ++output;
+    for (std::size_t i = width; i > 0; --i) {
+        *output = std::byte(static_cast<std::uint8_t>(count >> ((i - 1) * 8)));
+        ++output;
     }
+    return output;
 }
 
+/** Output iterator that discards everything written to it, only counting the
+ * bytes.  Used to size an encoding without producing it.
+ */
+class CountingIterator {
+  private:
+    std::size_t count_ = 0;
+
+  public:
+    struct Sink {
+        inline const Sink &operator=(std::byte) const noexcept {
+            return *this;
+        }
+    };
+
+    using difference_type = std::ptrdiff_t;
+    using value_type = void;
+
+    inline Sink operator*() const noexcept {
+        return {};
+    }
+
+    inline CountingIterator &operator++() noexcept {
+        ++count_;
+        return *this;
+    }
+
+    inline CountingIterator operator++(int) noexcept {
+        auto old = *this;
+        ++count_;
+        return old;
+    }
+
+    inline std::size_t count() const noexcept {
+        return count_;
+    }
+};
+
+/** Output iterator that folds everything written to it into a 64-bit FNV-1a
+ * hash.  Hashing an encoding this way never materializes it.  Floats encode
+ * their canonical value into it; see Value::hash.
+ */
+class HashingIterator {
+  private:
+    std::uint64_t state_ = 0xcbf29ce484222325ull;
+
+  public:
+    struct Sink {
+        std::uint64_t *state;
+
+        inline const Sink &operator=(const std::byte byte) const noexcept {
+            *state = (*state ^ static_cast<std::uint64_t>(byte)) * 0x100000001b3ull;
+            return *this;
+        }
+    };
+
+    using difference_type = std::ptrdiff_t;
+    using value_type = void;
+
+    inline Sink operator*() noexcept {
+        return {&state_};
+    }
+
+    inline HashingIterator &operator++() noexcept {
+        return *this;
+    }
+
+    inline HashingIterator operator++(int) noexcept {
+        return *this;
+    }
+
+    inline std::uint64_t hash() const noexcept {
+        return state_;
+    }
+};
+
+/** Output iterator that orders everything written to it against an expected
+ * encoding, byte by byte, without materializing what is written.  Like
+ * HashingIterator, floats encode their canonical value into it.
+ */
+class ComparingIterator {
+  private:
+    std::span<const std::byte> expected_;
+    std::size_t position_ = 0;
+    std::strong_ordering order_ = std::strong_ordering::equal;
+
+  public:
+    struct Sink {
+        ComparingIterator *iterator;
+
+        inline const Sink &operator=(const std::byte byte) const noexcept {
+            auto &it = *iterator;
+            if (it.order_ == std::strong_ordering::equal) {
+                it.order_ = it.position_ < it.expected_.size() ? byte <=> it.expected_[it.position_]
+                                                               : std::strong_ordering::greater;
+            }
+            ++it.position_;
+            return *this;
+        }
+    };
+
+    using difference_type = std::ptrdiff_t;
+    using value_type = void;
+
+    ComparingIterator() noexcept = default;
+
+    inline explicit ComparingIterator(const std::span<const std::byte> expected) noexcept :
+        expected_(expected) {
+    }
+
+    inline Sink operator*() noexcept {
+        return {this};
+    }
+
+    inline ComparingIterator &operator++() noexcept {
+        return *this;
+    }
+
+    inline ComparingIterator operator++(int) noexcept {
+        return *this;
+    }
+
+    /** How what was written orders against the expected encoding.
+     */
+    inline std::strong_ordering order() const noexcept {
+        if (order_ == std::strong_ordering::equal && position_ < expected_.size()) {
+            return std::strong_ordering::less;
+        }
+        return order_;
+    }
+};
+
+namespace detail {
+/** Outputs that floats encode their canonical value into, so they see every
+ * value operator== holds equal as the same one.
+ */
+template <typename OutputIt>
+concept CanonicalOutput =
+  std::same_as<OutputIt, HashingIterator> || std::same_as<OutputIt, ComparingIterator>;
+} // namespace detail
+
 /** Convert from float to float16 only if it can be done losslessly.
  */
 inline std::optional<std::array<std::byte, 2>> lossless_float16(const float value) {
@@ -432,6 +590,11 @@ class ValuePointer {
 
     inline bool operator==(const ValuePointer &other) const noexcept;
     inline std::strong_ordering operator<=>(const ValuePointer &other) const noexcept;
+
+    // Compare against a Value directly, so maps can be searched without
+    // allocating a key.
+    inline bool operator==(const Value &other) const noexcept;
+    inline std::strong_ordering operator<=>(const Value &other) const noexcept;
 };
 
 // All the individual types need to be wrapped, because they all need to support
@@ -464,7 +627,7 @@ struct Positive {
 
     template <typename OutputIt>
     OutputIt encode(const OutputIt iterator) const {
-        return write_header(iterator, Header(MajorType::PositiveInteger, value));
+        return write_header(iterator, MajorType::PositiveInteger, value);
     }
 };
 
@@ -485,7 +648,7 @@ struct Negative {
     }
 
     inline bool is_valid_int64() const noexcept {
-        return count < 9223372036854775807ul;
+        return count <= 9223372036854775807ul;
     }
 
     bool operator==(const Negative &other) const noexcept = default;
@@ -493,34 +656,107 @@ struct Negative {
 
     template <typename OutputIt>
     OutputIt encode(const OutputIt iterator) const {
-        return write_header(iterator, Header(MajorType::NegativeInteger, count));
+        return write_header(iterator, MajorType::NegativeInteger, count);
+    }
+};
+
+/** A view of bytes kept alive by a reference count.  Copies and slices
+ * share the same storage, which is released along with the last of them, so
+ * strings holding one are safe to keep and to hand to other threads.
+ */
+class SharedBuffer {
+  private:
+    std::span<const std::byte> bytes_;
+    std::shared_ptr<const void> owner_;
+
+  public:
+    SharedBuffer() noexcept = default;
+
+    /** Refer to bytes, kept alive by owner.
+     */
+    inline SharedBuffer(
+      std::shared_ptr<const void> owner, const std::span<const std::byte> bytes) noexcept :
+        bytes_(bytes),
+        owner_(std::move(owner)) {
+    }
+
+    /** Take over a vector's storage without copying it.
+     */
+    inline explicit SharedBuffer(std::vector<std::byte> bytes) {
+        auto owner = std::make_shared<const std::vector<std::byte>>(std::move(bytes));
+        bytes_ = *owner;
+        owner_ = std::move(owner);
+    }
+
+    /** Adopt size bytes of an array, released through its deleter.
+     */
+    template <typename Deleter>
+    inline SharedBuffer(std::unique_ptr<std::byte[], Deleter> bytes, const std::size_t size) :
+        bytes_(bytes.get(), size),
+        owner_(std::move(bytes)) {
+    }
+
+    /** Adopt size bytes from elsewhere, such as a network stack's frame,
+     * released by calling deleter(data).
+     */
+    template <typename Deleter>
+    inline SharedBuffer(const std::byte *const data, const std::size_t size, Deleter deleter) :
+        bytes_(data, size),
+        owner_(data, std::move(deleter)) {
+    }
+
+    inline std::span<const std::byte> bytes() const noexcept {
+        return bytes_;
+    }
+
+    inline std::size_t size() const noexcept {
+        return bytes_.size();
+    }
+
+    /** How many buffers share the storage, or 0 for an empty one.
+     */
+    inline long use_count() const noexcept {
+        return owner_.use_count();
+    }
+
+    /** The size bytes starting at offset, sharing this storage.
+     */
+    inline SharedBuffer slice(const std::size_t offset, const std::size_t size) const {
+        if (offset > bytes_.size() || size > bytes_.size() - offset) {
+            throw std::out_of_range("slice out of range");
+        }
+        return SharedBuffer(owner_, bytes_.subspan(offset, size));
+    }
+
+    /** The slice covering bytes, if they lie inside this buffer.
+     */
+    inline std::optional<SharedBuffer> slice(const std::span<const std::byte> bytes) const {
+        const std::less<const std::byte *> less;
+        if (less(bytes.data(), bytes_.data()) ||
+            less(bytes_.data() + bytes_.size(), bytes.data() + bytes.size())) {
+            return std::nullopt;
+        }
+        return SharedBuffer(owner_, bytes);
     }
 };
 
 /** String wrapper with CBOR ordering rules.
  */
 struct ByteString {
-    std::variant<std::vector<std::byte>, std::span<const std::byte>> value;
+    std::variant<std::vector<std::byte>, std::span<const std::byte>, SharedBuffer> value;
     template <class... Args>
     inline ByteString(Args &&...t) : value(std::forward<Args>(t)...) {
     }
 
+    inline std::size_t size() const noexcept {
+        return static_cast<std::span<const std::byte>>(*this).size();
+    }
+
     template <typename OutputIt>
     OutputIt encode(OutputIt output) const {
-        const auto iterator = write_header(
-          output,
-          Header(
-            MajorType::ByteString,
-            std::visit(
-              [](auto &&value) {
-                  return value.size();
-              },
-              value)));
-        return std::visit(
-          [iterator = std::move(iterator)](auto &&value) {
-              return std::ranges::copy(value, iterator).out;
-          },
-          value);
+        const std::span<const std::byte> bytes = *this;
+        output = write_header(output, MajorType::ByteString, bytes.size());
+        return std::ranges::copy(bytes, output).out;
     }
 
     bool operator==(const ByteString &other) const noexcept {
@@ -530,20 +766,10 @@ struct ByteString {
     }
 
     inline std::strong_ordering operator<=>(const ByteString &other) const noexcept {
-        const auto size_compare = //
-          std::visit(
-            [](auto &&value) {
-                return value.size();
-            },
-            value) <=>
-          std::visit(
-            [](auto &&value) {
-                return value.size();
-            },
-            other.value);
+        const std::span<const std::byte> lhs = *this;
+        const std::span<const std::byte> rhs = other;
+        const auto size_compare = lhs.size() <=> rhs.size();
         if (size_compare == std::strong_ordering::equal) {
-            const auto lhs = static_cast<std::span<const std::byte>>(*this);
-            const auto rhs = static_cast<std::span<const std::byte>>(other);
             return std::lexicographical_compare_three_way(
               std::begin(lhs),
               std::end(lhs),
@@ -555,48 +781,58 @@ struct ByteString {
     }
 
     inline operator std::span<const std::byte>() const noexcept {
-        return std::visit(
-          [](auto &&value) {
-              return std::span(value);
-          },
-          value);
+        if (const auto owned = std::get_if<0>(&value)) {
+            return *owned;
+        } else if (const auto view = std::get_if<1>(&value)) {
+            return *view;
+        }
+        return std::get_if<2>(&value)->bytes();
+    }
+
+    /** Whether the bytes belong to someone else's buffer.
+     */
+    inline bool borrowed() const noexcept {
+        return value.index() == 1;
+    }
+
+    /** Copy borrowed bytes into owned storage.  Shared bytes are left as
+     * they are.
+     */
+    inline void own() {
+        if (const auto view = std::get_if<1>(&value)) {
+            value = std::vector<std::byte>(view->begin(), view->end());
+        }
+    }
+
+    /** Turn borrowed bytes that lie inside buffer into a slice of it.
+     */
+    inline void share(const SharedBuffer &buffer) {
+        if (const auto view = std::get_if<1>(&value)) {
+            if (auto slice = buffer.slice(*view)) {
+                value = std::move(*slice);
+            }
+        }
     }
 };
 
 /** String wrapper with CBOR ordering rules.
  */
 struct Utf8String {
-    std::variant<std::u8string, std::u8string_view> value;
+    std::variant<std::u8string, std::u8string_view, SharedBuffer> value;
 
     template <class... Args>
     Utf8String(Args &&...t) : value(std::forward<Args>(t)...) {
     }
 
+    inline std::size_t size() const noexcept {
+        return static_cast<std::u8string_view>(*this).size();
+    }
+
     template <typename OutputIt>
     OutputIt encode(OutputIt output) const {
-        const auto iterator = write_header(
-          output,
-          Header(
-            MajorType::Utf8String,
-            std::visit(
-              [](auto &&value) {
-                  return value.size();
-              },
-              value)));
-        // return std::ranges::transform(value.begin(), value.end(), iterator, [](const auto c) {
-        //     return std::byte(c);
-        // });
-        return std::visit(
-          [iterator = std::move(iterator)](auto &&value) {
-              return std::ranges::transform(
-                       value,
-                       iterator,
-                       [](const auto c) {
-                           return std::byte(c);
-                       })
-                .out;
-          },
-          value);
+        const std::u8string_view string = *this;
+        output = write_header(output, MajorType::Utf8String, string.size());
+        return std::ranges::copy(std::as_bytes(std::span(string)), output).out;
     }
 
     bool operator==(const Utf8String &other) const noexcept {
@@ -604,30 +840,49 @@ struct Utf8String {
     }
 
     inline std::strong_ordering operator<=>(const Utf8String &other) const noexcept {
-        const auto size_compare = //
-          std::visit(
-            [](auto &&value) {
-                return value.size();
-            },
-            value) <=>
-          std::visit(
-            [](auto &&value) {
-                return value.size();
-            },
-            other.value);
+        const std::u8string_view lhs = *this;
+        const std::u8string_view rhs = other;
+        const auto size_compare = lhs.size() <=> rhs.size();
         if (size_compare == std::strong_ordering::equal) {
-            return value <=> other.value;
+            return lhs <=> rhs;
         } else {
             return size_compare;
         }
     }
 
     inline operator std::u8string_view() const noexcept {
-        return std::visit(
-          [](auto &&value) {
-              return std::u8string_view(value);
-          },
-          value);
+        if (const auto owned = std::get_if<0>(&value)) {
+            return *owned;
+        } else if (const auto view = std::get_if<1>(&value)) {
+            return *view;
+        }
+        const auto bytes = std::get_if<2>(&value)->bytes();
+        return {reinterpret_cast<const char8_t *>(bytes.data()), bytes.size()};
+    }
+
+    /** Whether the string belongs to someone else's buffer.
+     */
+    inline bool borrowed() const noexcept {
+        return value.index() == 1;
+    }
+
+    /** Copy a borrowed string into owned storage.  A shared string is left
+     * as it is.
+     */
+    inline void own() {
+        if (const auto view = std::get_if<1>(&value)) {
+            value = std::u8string(*view);
+        }
+    }
+
+    /** Turn a borrowed string that lies inside buffer into a slice of it.
+     */
+    inline void share(const SharedBuffer &buffer) {
+        if (const auto view = std::get_if<1>(&value)) {
+            if (auto slice = buffer.slice(std::as_bytes(std::span(*view)))) {
+                value = std::move(*slice);
+            }
+        }
     }
 };
 
@@ -663,15 +918,37 @@ struct Array {
     inline operator std::vector<ValuePointer> &() noexcept {
         return value;
     }
+
+    /** Construct a Value from args at the end, and return it.
+     */
+    template <class... Args>
+    inline Value &emplace_back(Args &&...args);
+
+    /** An Array with one element constructed from each argument, reserving
+     * its storage once.
+     */
+    template <class... Args>
+    static inline Array of(Args &&...elements);
 };
 
 struct Map {
-    std::map<ValuePointer, ValuePointer> value;
+    // The transparent comparator lets find and friends take a plain Value.
+    std::map<ValuePointer, ValuePointer, std::less<>> value;
+
+    using iterator = std::map<ValuePointer, ValuePointer, std::less<>>::iterator;
 
     template <class... Args>
+        requires std::constructible_from<decltype(value), Args...>
     inline Map(Args &&...t) : value(std::forward<Args>(t)...) {
     }
 
+    /** Take over the entries of a map using the default comparator, as value
+     * was before it became transparent, relinking its nodes.
+     */
+    inline Map(std::map<ValuePointer, ValuePointer> entries) noexcept {
+        value.merge(entries);
+    }
+
     template <typename OutputIt>
     inline OutputIt encode(OutputIt output) const;
 
@@ -688,47 +965,231 @@ struct Map {
         }
     }
 
-    inline operator const std::map<ValuePointer, ValuePointer> &() const noexcept {
+    inline operator const std::map<ValuePointer, ValuePointer, std::less<>> &() const noexcept {
         return value;
     }
 
-    inline operator std::map<ValuePointer, ValuePointer> &() noexcept {
+    inline operator std::map<ValuePointer, ValuePointer, std::less<>> &() noexcept {
         return value;
     }
-};
 
-struct SemanticTag {
-    std::uint64_t id = -1;
-    ValuePointer value;
+    /** Set key to val.  Takes amortized constant time and one comparison
+     * when key sorts after every key present, and logarithmic time otherwise.
+     * Returns whether key was new.
+     */
+    inline bool append(ValuePointer key, ValuePointer val);
 
-    template <class... Args>
-    SemanticTag(std::uint64_t id, Args &&...t) : id(id), value(std::forward<Args>(t)...) {
-    }
+    /** Build from entries, in linear time when they are in key order.  Out
+     * of order entries still land in place, at logarithmic cost each.  Where
+     * a key repeats, the last value wins.
+     */
+    static inline Map from_sorted(std::vector<std::pair<ValuePointer, ValuePointer>> entries);
 
-    inline bool operator==(const SemanticTag &other) const noexcept = default;
-    inline auto operator<=>(const SemanticTag &other) const noexcept = default;
+    /** The union of maps, relinking their nodes rather than reallocating,
+     * in O(n log k) for n entries across k maps.  Where maps share a key,
+     * the value from the last of them wins, as if each were inserted in turn
+     * with insert_or_assign.
+     */
+    static inline Map merge(std::vector<Map> maps);
 
-    template <typename OutputIt>
-    OutputIt encode(OutputIt output) const;
+    /** Add key, with a value constructed from args, unless key is already
+     * present, in which case args are left untouched.  Like append(), keys
+     * that sort after every existing key take one comparison.  Returns the
+     * entry for key and whether it was added.
+     */
+    template <typename K, class... Args>
+    inline std::pair<iterator, bool> try_emplace(K &&key, Args &&...args);
 };
 
-struct Boolean {
-    bool value = false;
+/** Map that keeps its entries in the order they were decoded or appended, and
+ * encodes them in that order, so a decode and encode round trip reproduces
+ * the input.  Duplicate keys are kept rather than dropped; duplicates()
+ * reports them.
+ *
+ * Lookups scan linearly for small maps.  Larger maps build a hashed index on
+ * decode or on their first non-const lookup, extended as entries are appended.
+ * Const lookups never modify the map, so any number of threads may read it at
+ * once; they use the index as far as it reaches and scan the entries past it.
+ * If entries are removed or keys are modified in place, call reindex().
+ *
+ * As a Value, it compares and orders as the Map its encoding would be read
+ * as: it equals a Map only when its entries are in canonical order, and it
+ * sorts against other maps by its entries in wire order.
+ */
+struct OrderedMap {
+    std::vector<std::pair<ValuePointer, ValuePointer>> value;
 
-    Boolean() noexcept = default;
-    inline Boolean(const bool value) noexcept : value(value) {
+    /** Maps at least this large get a hashed index.
+     */
+    static constexpr std::size_t index_threshold = 16;
+
+    template <class... Args>
+    inline OrderedMap(Args &&...t) : value(std::forward<Args>(t)...) {
     }
 
     template <typename OutputIt>
-    OutputIt encode(OutputIt iterator) const {
-        return write_header(iterator, Header{MajorType::SpecialFloat, value ? 21u : 20u});
+    inline OutputIt encode(OutputIt output) const;
+
+    inline bool operator==(const OrderedMap &other) const noexcept {
+        return value == other.value;
     }
 
-    inline bool operator==(const Boolean &other) const noexcept {
-        return value == other.value || (std::isnan(value) && std::isnan(other.value));
+    inline std::strong_ordering operator<=>(const OrderedMap &other) const noexcept {
+        const auto size_compare = value.size() <=> other.value.size();
+        if (std::is_lt(size_compare)) {
+            return std::strong_ordering::less;
+        } else if (std::is_gt(size_compare)) {
+            return std::strong_ordering::greater;
+        } else {
+            return value <=> other.value;
+        }
     }
 
-    inline std::strong_ordering operator<=>(const Boolean &other) const noexcept {
+    /** Find the first entry with the given key, or end() if there is none.
+     */
+    inline std::vector<std::pair<ValuePointer, ValuePointer>>::iterator find(const Value &key);
+    inline std::vector<std::pair<ValuePointer, ValuePointer>>::const_iterator find(
+      const Value &key) const;
+
+    /** Indices of every entry whose key already appeared earlier in the map.
+     */
+    inline std::vector<std::size_t> duplicates() const;
+
+    /** Index every entry not yet indexed.  Non-const lookups on large maps
+     * do this themselves; call it before handing a map to readers that only
+     * hold it const.
+     */
+    inline void build_index();
+
+    /** Drop the hashed index, so it is rebuilt on the next non-const lookup.
+     */
+    inline void reindex() noexcept {
+        index_.reset();
+    }
+
+    inline operator const std::vector<std::pair<ValuePointer, ValuePointer>> &() const noexcept {
+        return value;
+    }
+
+    inline operator std::vector<std::pair<ValuePointer, ValuePointer>> &() noexcept {
+        return value;
+    }
+
+  private:
+    // Key hash to entry index, covering entries [0, indexed).  Kept behind a
+    // pointer so OrderedMap costs no more than a vector in the Value variant.
+    struct Index {
+        std::unordered_multimap<std::uint64_t, std::size_t> entries;
+        std::size_t indexed = 0;
+    };
+    std::unique_ptr<Index> index_;
+
+    inline std::size_t find_index(const Value &key) const;
+};
+
+/** Map laid out for small integer keys, as used by COSE, CWT, and most RPC
+ * envelopes.  Keys from min_key to max_key, the ones with a single-byte
+ * encoding, live in a slot vector indexed directly by key, so looking one up
+ * is O(1) and never builds a key.  Any other key falls back to an ordinary
+ * Map.  Encodes to exactly the same bytes as the equivalent Map.
+ */
+struct IntMap {
+    static constexpr std::int64_t min_key = -24;
+    static constexpr std::int64_t max_key = 23;
+
+    /** Values for small keys, in zigzag order (0, -1, 1, -2, ...), so the
+     * vector stays short when keys are near zero.  Absent keys are null.
+     */
+    std::vector<ValuePointer> slots;
+
+    /** Every other key.
+     */
+    Map rest;
+
+    IntMap() noexcept = default;
+
+    /** The slot index for a key, if the key is a small integer.
+     */
+    static inline std::optional<std::size_t> slot(const std::int64_t key) noexcept {
+        if (key < min_key || key > max_key) {
+            return std::nullopt;
+        }
+        return key >= 0 ? static_cast<std::size_t>(key) * 2
+                        : static_cast<std::size_t>(-key) * 2 - 1;
+    }
+
+    static inline std::optional<std::size_t> slot(const Value &key) noexcept;
+
+    /** The key held in a slot index.
+     */
+    static inline std::int64_t key(const std::size_t slot) noexcept {
+        return slot % 2 == 0 ? static_cast<std::int64_t>(slot / 2)
+                             : -static_cast<std::int64_t>(slot / 2) - 1;
+    }
+
+    inline std::size_t size() const noexcept {
+        return static_cast<std::size_t>(std::ranges::count_if(slots, [](const auto &slot) {
+                   return static_cast<const std::unique_ptr<Value> &>(slot) != nullptr;
+               })) +
+          rest.value.size();
+    }
+
+    /** Look up a value, returning nullptr if the key is absent.
+     */
+    inline Value *find(std::int64_t key);
+    inline const Value *find(std::int64_t key) const;
+    inline Value *find(const Value &key);
+    inline const Value *find(const Value &key) const;
+
+    /** Insert an entry unless its key is already present, like
+     * std::map::insert.  Returns whether it was inserted.
+     */
+    inline bool insert(Value key, Value value);
+
+    /** Call f(key, value) for every entry, in encoding order.
+     */
+    template <typename F>
+    inline void for_each(F &&f) const;
+
+    template <typename OutputIt>
+    inline OutputIt encode(OutputIt output) const;
+
+    inline bool operator==(const IntMap &other) const noexcept;
+    inline std::strong_ordering operator<=>(const IntMap &other) const noexcept;
+};
+
+struct SemanticTag {
+    std::uint64_t id = -1;
+    ValuePointer value;
+
+    template <class... Args>
+    SemanticTag(std::uint64_t id, Args &&...t) : id(id), value(std::forward<Args>(t)...) {
+    }
+
+    inline bool operator==(const SemanticTag &other) const noexcept = default;
+    inline auto operator<=>(const SemanticTag &other) const noexcept = default;
+
+    template <typename OutputIt>
+    OutputIt encode(OutputIt output) const;
+};
+
+struct Boolean {
+    bool value = false;
+
+    Boolean() noexcept = default;
+    inline Boolean(const bool value) noexcept : value(value) {
+    }
+
+    template <typename OutputIt>
+    OutputIt encode(OutputIt iterator) const {
+        return write_header(iterator, MajorType::SpecialFloat, value ? 21u : 20u);
+    }
+
+    inline bool operator==(const Boolean &other) const noexcept {
+        return value == other.value || (std::isnan(value) && std::isnan(other.value));
+    }
+
+    inline std::strong_ordering operator<=>(const Boolean &other) const noexcept {
         std::array<std::byte, 5> first;
         std::array<std::byte, 5> second;
         std::ranges::fill(first, std::byte(0));
@@ -746,7 +1207,7 @@ struct Boolean {
 struct Null {
     template <typename OutputIt>
     OutputIt encode(OutputIt iterator) const {
-        return write_header(iterator, Header{MajorType::SpecialFloat, 22});
+        return write_header(iterator, MajorType::SpecialFloat, 22);
     }
 
     inline bool operator==(const Null &) const noexcept {
@@ -761,7 +1222,7 @@ struct Null {
 struct Undefined {
     template <typename OutputIt>
     OutputIt encode(OutputIt iterator) const {
-        return write_header(iterator, Header{MajorType::SpecialFloat, 23});
+        return write_header(iterator, MajorType::SpecialFloat, 23);
     }
 
     inline bool operator==(const Undefined &) const noexcept {
@@ -792,43 +1253,52 @@ struct Float {
           std::endian::native == std::endian::big || std::endian::native == std::endian::little,
           "mixed endian architectures can not be supported yet");
 
-        const float f = value;
-
-        if (std::isnan(value) || static_cast<double>(f) == value) {
-            const auto float16 = lossless_float16(f);
-            if (float16) {
-                return write_header(
-                  iterator,
-                  Header{
-                    MajorType::SpecialFloat,
-                    Count(std::in_place_index<2>, from_be_bytes<std::uint16_t>(*float16))});
-            } else {
-                return write_header(
-                  iterator,
-                  Header{
-                    MajorType::SpecialFloat,
-                    Count(std::in_place_index<3>, from_be_bytes<std::uint32_t>(to_be_bytes(f)))});
+        // Hashes have to agree with operator==, so they see every value it
+        // holds equal as the same one.
+        const double encoded = detail::CanonicalOutput<OutputIt> ? canonical() : value;
+        const float f = encoded;
+
+        // The headers are written directly, as the SpecialFloat type byte with
+        // short counts 25, 26 and 27.
+        if (std::isnan(encoded) || static_cast<double>(f) == encoded) {
+            if (const auto float16 = lossless_float16(f)) {
+                *iterator = std::byte(0xf9);
+                ++iterator;
+                return std::ranges::copy(*float16, iterator).out;
             }
-        } else {
-            return write_header(
-              iterator,
-              Header{
-                MajorType::SpecialFloat,
-                Count(std::in_place_index<4>, from_be_bytes<std::uint64_t>(to_be_bytes(value)))});
+            *iterator = std::byte(0xfa);
+            ++iterator;
+            return std::ranges::copy(to_be_bytes(f), iterator).out;
         }
+        *iterator = std::byte(0xfb);
+        ++iterator;
+        return std::ranges::copy(to_be_bytes(encoded), iterator).out;
+    }
+
+    /** The value with -0.0 folded into 0.0 and every NaN into the same one,
+     * which are the values that compare equal but encode differently.
+     */
+    inline double canonical() const noexcept {
+        if (std::isnan(value)) {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+        return value == 0.0 ? 0.0 : value;
     }
 
     inline bool operator==(const Float &other) const noexcept {
         return value == other.value || (std::isnan(value) && std::isnan(other.value));
     }
 
+    /** Encoded order, of the canonical values so that it agrees with
+     * operator==.
+     */
     inline std::strong_ordering operator<=>(const Float &other) const noexcept {
-        std::array<std::byte, 5> first;
-        std::array<std::byte, 5> second;
+        std::array<std::byte, 9> first;
+        std::array<std::byte, 9> second;
         std::ranges::fill(first, std::byte(0));
         std::ranges::fill(second, std::byte(0));
-        encode(first.begin());
-        other.encode(second.begin());
+        Float(canonical()).encode(first.begin());
+        Float(other.canonical()).encode(second.begin());
         return first <=> second;
     }
 
@@ -854,6 +1324,181 @@ struct Break {
     }
 };
 
+/** Write a signed integer as a Positive or Negative.
+ */
+template <typename OutputIt>
+OutputIt write_integer(OutputIt output, const std::int64_t value) {
+    if (value >= 0) {
+        return write_header(
+          output,
+          Header(MajorType::PositiveInteger, static_cast<std::uint64_t>(value)));
+    }
+    return write_header(
+      output,
+      Header(MajorType::NegativeInteger, static_cast<std::uint64_t>(-1 - value)));
+}
+
+/** Date and time from tag 0 (an RFC 3339 string) or tag 1 (seconds since the
+ * epoch).  Tag 0 keeps its UTC offset and encodes back with it.  Tag 1
+ * encodes as an integer when the time is a whole second and a float
+ * otherwise.  Like every tag, it compares by what it encodes to, so times
+ * that encode alike are equal.
+ *
+ * The time is kept as plain integers, so this header does not need <chrono>.
+ * varbor/tags.hxx defines time() and offset(), which return std::chrono
+ * types.
+ */
+struct DateTime {
+    std::uint64_t id = 1;
+    // UTC time since the epoch.
+    std::int64_t nanoseconds = 0;
+    // The UTC offset tag 0 was written with.
+    std::int32_t offset_minutes = 0;
+
+    inline auto time() const noexcept;
+    inline auto offset() const noexcept;
+
+    template <typename OutputIt>
+    OutputIt encode(OutputIt output) const;
+
+    inline bool operator==(const DateTime &other) const noexcept;
+    inline std::strong_ordering operator<=>(const DateTime &other) const noexcept;
+};
+
+/** Bignum from tag 2 or tag 3 whose magnitude fits in 128 bits.  Like
+ * Positive and Negative, the value is the magnitude for tag 2 and
+ * -1 - magnitude for tag 3.
+ */
+struct BigNum {
+    bool negative = false;
+    std::uint64_t high = 0;
+    std::uint64_t low = 0;
+
+    template <typename OutputIt>
+    OutputIt encode(OutputIt output) const {
+        output = write_header(output, MajorType::SemanticTag, negative ? 3u : 2u);
+        std::array<std::byte, 16> bytes;
+        std::ranges::copy(to_be_bytes(high), bytes.begin());
+        std::ranges::copy(to_be_bytes(low), bytes.begin() + 8);
+        // Preferred serialization has no leading zero bytes.
+        const auto first = std::ranges::find_if(bytes, [](const auto byte) {
+            return byte != std::byte(0);
+        });
+        output = write_header(
+          output,
+          Header(MajorType::ByteString, static_cast<std::uint64_t>(bytes.end() - first)));
+        return std::copy(first, bytes.end(), output);
+    }
+
+#ifdef VARBOR_HAS_INT128
+    inline UInt128 magnitude() const noexcept {
+        return (static_cast<UInt128>(high) << 64) | low;
+    }
+
+    /** The value as a signed 128-bit integer, if it fits.
+     */
+    inline std::optional<Int128> to_int128() const noexcept {
+        if (high >> 63) {
+            return std::nullopt;
+        }
+        const auto value = static_cast<Int128>(magnitude());
+        return negative ? -1 - value : value;
+    }
+#endif
+
+    bool operator==(const BigNum &other) const noexcept = default;
+    auto operator<=>(const BigNum &other) const noexcept = default;
+};
+
+/** Decimal fraction (tag 4, mantissa * 10^exponent) or bigfloat (tag 5,
+ * mantissa * 2^exponent) whose parts both fit in 64 bits.
+ */
+struct DecimalFraction {
+    std::uint64_t id = 4;
+    std::int64_t exponent = 0;
+    std::int64_t mantissa = 0;
+
+    template <typename OutputIt>
+    OutputIt encode(OutputIt output) const {
+        output = write_header(output, MajorType::SemanticTag, id);
+        output = write_header(output, MajorType::Array, 2u);
+        output = write_integer(output, exponent);
+        return write_integer(output, mantissa);
+    }
+
+    bool operator==(const DecimalFraction &other) const noexcept = default;
+    // Signed parts order differently from their encodings.
+    inline std::strong_ordering operator<=>(const DecimalFraction &other) const noexcept;
+};
+
+/** UUID from tag 37.
+ */
+struct Uuid {
+    std::array<std::byte, 16> bytes{};
+
+    template <typename OutputIt>
+    OutputIt encode(OutputIt output) const {
+        output = write_header(output, MajorType::SemanticTag, 37u);
+        output = write_header(output, MajorType::ByteString, bytes.size());
+        return std::ranges::copy(bytes, output).out;
+    }
+
+    bool operator==(const Uuid &other) const noexcept = default;
+    auto operator<=>(const Uuid &other) const noexcept = default;
+};
+
+struct DecodePolicy;
+
+/** Encoded CBOR data item from tag 24, kept as its raw bytes and only decoded
+ * on request.  Encoding writes the bytes back untouched, so forwarding an
+ * envelope never round-trips its payload through Value.
+ *
+ * With DecodePolicy::borrow_embedded_cbor, bytes is a span into the decode
+ * input, which must then outlive this node or be detached with own().  Decoding
+ * a SharedBuffer makes bytes a slice of it instead.
+ */
+struct EmbeddedCbor {
+    ByteString bytes;
+
+    /** Wrap an item, encoding it into owned bytes.
+     */
+    static inline EmbeddedCbor wrap(const Value &value);
+
+    /** Decode the embedded item.  Decoding with the same policy as the
+     * envelope means a borrowing policy borrows from the envelope's buffer
+     * here too.
+     */
+    template <typename Policy = DecodePolicy>
+    inline Value decode_nested() const;
+
+    /** Whether bytes refers to someone else's buffer.
+     */
+    inline bool borrowed() const noexcept {
+        return bytes.borrowed();
+    }
+
+    /** Copy borrowed bytes into owned storage.
+     */
+    inline void own() {
+        bytes.own();
+    }
+
+    /** Turn borrowed bytes that lie inside buffer into a slice of it.
+     */
+    inline void share(const SharedBuffer &buffer) {
+        bytes.share(buffer);
+    }
+
+    template <typename OutputIt>
+    OutputIt encode(OutputIt output) const {
+        output = write_header(output, MajorType::SemanticTag, 24u);
+        return bytes.encode(output);
+    }
+
+    bool operator==(const EmbeddedCbor &other) const noexcept = default;
+    std::strong_ordering operator<=>(const EmbeddedCbor &other) const noexcept = default;
+};
+
 using Variant = std::variant<
   Positive,
   Negative,
@@ -866,12 +1511,118 @@ using Variant = std::variant<
   Null,
   Undefined,
   Float,
-  Break>;
+  Break,
+  OrderedMap,
+  IntMap,
+  DateTime,
+  BigNum,
+  DecimalFraction,
+  Uuid,
+  EmbeddedCbor>;
+
+namespace detail {
+/** The index of T among the alternatives of a variant, or the number of
+ * alternatives if it is not one of them.
+ */
+template <typename T, typename Variant>
+struct variant_index;
+
+template <typename T, typename... Types>
+struct variant_index<T, std::variant<Types...>> {
+    static constexpr std::size_t value = [] {
+        std::size_t index = 0;
+        ((std::same_as<T, Types> ? false : (++index, true)) && ...);
+        return index;
+    }();
+};
+
+template <typename T>
+concept Alternative = variant_index<T, Variant>::value < std::variant_size_v<Variant>;
+
+/** Alternatives that are layouts of a CBOR map.
+ */
+template <typename T>
+concept MapLayout = std::same_as<T, Map> || std::same_as<T, OrderedMap> || std::same_as<T, IntMap>;
+
+/** Typed tag nodes whose encodings are short enough to build on the stack.
+ */
+template <typename T>
+concept BoundedTag = std::same_as<T, DateTime> || std::same_as<T, BigNum> ||
+  std::same_as<T, DecimalFraction> || std::same_as<T, Uuid>;
+
+/** Alternatives that encode as a semantic tag.
+ */
+template <typename T>
+concept TagLayout = std::same_as<T, SemanticTag> || BoundedTag<T> || std::same_as<T, EmbeddedCbor>;
+
+/** The index of the alternative that the one at index orders as.  Layouts
+ * of the same kind of item order as one alternative, so they sort where
+ * their encodings would.
+ */
+constexpr std::size_t kind(const std::size_t index) noexcept {
+    if (index == variant_index<OrderedMap, Variant>::value ||
+      index == variant_index<IntMap, Variant>::value) {
+        return variant_index<Map, Variant>::value;
+    }
+    if (index >= variant_index<DateTime, Variant>::value &&
+      index <= variant_index<EmbeddedCbor, Variant>::value) {
+        return variant_index<SemanticTag, Variant>::value;
+    }
+    return index;
+}
+
+/** Integer types that Value converts to Positive or Negative.
+ */
+template <typename T>
+concept Integer = std::integral<T> && !std::same_as<T, bool> && !std::same_as<T, char> &&
+  !std::same_as<T, char8_t> && !std::same_as<T, char16_t> && !std::same_as<T, char32_t> &&
+  !std::same_as<T, wchar_t>;
+
+/** Types that a Value can be compared with directly.
+ */
+template <typename T>
+concept Comparable = std::same_as<T, bool> || std::same_as<T, std::nullptr_t> ||
+  std::floating_point<T> || Integer<T> || std::convertible_to<const T &, std::u8string_view> ||
+  std::convertible_to<const T &, std::span<const std::byte>> || Alternative<T>;
+
+/** Call f with the alternative that other would become as a Value.  Strings
+ * become views, so nothing is allocated.
+ */
+template <Comparable T, typename F>
+inline auto with_alternative(const T &other, F &&f) {
+    if constexpr (std::same_as<T, bool>) {
+        return f(Boolean(other));
+    } else if constexpr (std::same_as<T, std::nullptr_t>) {
+        return f(Null{});
+    } else if constexpr (std::floating_point<T>) {
+        return f(Float(other));
+    } else if constexpr (Integer<T>) {
+        if constexpr (std::is_signed_v<T>) {
+            if (other < 0) {
+                return f(Negative(static_cast<std::uint64_t>(-(other + 1))));
+            }
+        }
+        return f(Positive(static_cast<std::uint64_t>(other)));
+    } else if constexpr (std::convertible_to<const T &, std::u8string_view>) {
+        return f(Utf8String(static_cast<std::u8string_view>(other)));
+    } else if constexpr (std::convertible_to<const T &, std::span<const std::byte>>) {
+        return f(ByteString(static_cast<std::span<const std::byte>>(other)));
+    } else {
+        return f(other);
+    }
+}
+} // namespace detail
 
 class Value {
   private:
     Variant value_;
 
+    /** Call f on every string in the tree, including map keys and embedded
+     * CBOR.
+     */
+    template <typename F>
+    inline void each_string(const F &f);
+
   public:
     Value() noexcept : value_(Undefined{}) {
     }
@@ -931,6 +1682,33 @@ class Value {
     Value(std::vector<ValuePointer> value) noexcept : value_(Array(std::move(value))) {
     }
 
+    /** A byte string that borrows bytes instead of copying them, for trees
+     * built only to be encoded.  bytes must outlive the Value, or be copied
+     * in with deep_own().
+     */
+    static inline Value view(const std::span<const std::byte> bytes) noexcept {
+        return Value(ByteString(bytes));
+    }
+
+    /** A text string that borrows string instead of copying it, under the
+     * same rules as the byte string view.
+     */
+    static inline Value view(const std::u8string_view string) noexcept {
+        return Value(Utf8String(string));
+    }
+
+    static inline Value view(const char8_t *const string) noexcept {
+        return view(std::u8string_view(string));
+    }
+
+    // A view of a temporary would dangle immediately.
+    static Value view(std::vector<std::byte> &&) = delete;
+    static Value view(std::u8string &&) = delete;
+
+    Value(std::map<ValuePointer, ValuePointer, std::less<>> value) noexcept :
+        value_(Map(std::move(value))) {
+    }
+
     Value(std::map<ValuePointer, ValuePointer> value) noexcept : value_(Map(std::move(value))) {
     }
 
@@ -959,211 +1737,247 @@ class Value {
     }
 
     template <typename OutputIt>
-    OutputIt encode(OutputIt output) const {
-        return std::visit(
-          [output](const auto &value) {
-              return value.encode(output);
-          },
-          value_);
-    }
+    OutputIt encode(OutputIt output) const;
 
+    /** Encode into a new vector.  The size is computed first, so the items
+     * are written through a plain pointer and strings are copied in bulk.
+     */
     inline std::vector<std::byte> encode() const {
-        std::vector<std::byte> output;
-        std::visit(
-          [&output](const auto &value) {
-              value.encode(std::back_inserter(output));
-          },
-          value_);
+        std::vector<std::byte> output(encoded_size());
+        encode(output.data());
         return output;
     }
 
-    template <typename InputIt>
-    static inline std::tuple<InputIt, Value> decode(InputIt begin, const InputIt end) {
-        Header header;
-        std::tie(begin, header) = read_header(begin, end);
-        switch (header.type) {
-        case MajorType::PositiveInteger: {
-            return {begin, Value(Positive(header.get_count().value()))};
-        }
-        case MajorType::NegativeInteger: {
-            return {begin, Value(Negative(header.get_count().value()))};
-        }
-        case MajorType::ByteString: {
-            std::vector<std::byte> string;
-            const auto count = header.get_count();
-            if (count) {
-                string.reserve(*count);
-                if constexpr (std::contiguous_iterator<InputIt>) {
-                    const auto string_end = begin + *count;
-                    if (string_end > end) {
-                        throw EndOfInput("String reads past end of buffer");
-                    }
-                    std::copy(begin, string_end, std::back_inserter(string));
-                    begin = string_end;
-                } else {
-                    for (uint64_t i = 0; i < *count; ++i) {
-                        string.emplace_back();
-                        std::tie(begin, string.back()) = read(begin, end);
-                    }
-                }
-            } else {
-                Value value(Undefined{});
-                std::tie(begin, value) = Value::decode(begin, end);
-                for (; value != Value(Break{});
-                     std::tie(begin, value) = Value::decode(begin, end)) {
-                    const auto substring = std::get<ByteString>(std::move(value).value_);
-                    const std::span<const std::byte> view = substring;
-                    string.reserve(view.size());
-                    std::copy(view.begin(), view.end(), std::back_inserter(string));
-                }
-            }
-            return {begin, Value(ByteString(std::move(string)))};
-        }
-        case MajorType::Utf8String: {
-            std::u8string string;
-            const auto count = header.get_count();
-            if (count) {
-                string.reserve(*count);
-                if constexpr (std::contiguous_iterator<InputIt>) {
-                    const auto string_end = begin + *count;
-                    if (string_end > end) {
-                        throw EndOfInput("String reads past end of buffer");
-                    }
-                    std::transform(
-                      begin,
-                      string_end,
-                      std::back_inserter(string),
-                      [](const auto byte) {
-                          return static_cast<char8_t>(byte);
-                      });
-                    begin = string_end;
-                } else {
-                    for (uint64_t i = 0; i < *count; ++i) {
-                        std::byte byte;
-                        std::tie(begin, byte) = read(begin, end);
-                        string.push_back(static_cast<char8_t>(byte));
-                    }
-                }
-            } else {
-                Value value(Undefined{});
-                std::tie(begin, value) = Value::decode(begin, end);
-                for (; value != Value(Break{});
-                     std::tie(begin, value) = Value::decode(begin, end)) {
-                    const auto substring = std::get<Utf8String>(std::move(value).value_);
-                    const std::u8string_view view = substring;
-                    string.reserve(view.size());
-                    std::copy(view.begin(), view.end(), std::back_inserter(string));
-                }
-            }
-            return {begin, Value(Utf8String(std::move(string)))};
-        }
-        case MajorType::Array: {
-            std::vector<ValuePointer> array;
-            const auto count = header.get_count();
-            if (count) {
-                array.reserve(*count);
-                Value value(Undefined{});
-                for (uint64_t i = 0; i < *count; ++i) {
-                    std::tie(begin, value) = Value::decode(begin, end);
-                    array.push_back(std::make_unique<Value>(std::move(value)));
-                }
-            } else {
-                Value value(Undefined{});
-                std::tie(begin, value) = Value::decode(begin, end);
-                for (; value != Value(Break{});
-                     std::tie(begin, value) = Value::decode(begin, end)) {
-                    array.push_back(std::make_unique<Value>(std::move(value)));
-                }
+    /** The number of bytes encode would produce, computed without allocating.
+     */
+    inline std::size_t encoded_size() const {
+        return encode(CountingIterator{}).count();
+    }
+
+    /** A hash of the encoded form, computed without allocating.  Floats are
+     * hashed as Float::canonical(), so that 0.0 and -0.0, which compare equal
+     * but encode differently, hash alike, as every pair of equal values does.
+     */
+    inline std::uint64_t hash() const {
+        return encode(HashingIterator{}).hash();
+    }
+
+    /** Copy every borrowed string in the tree, including map keys, into owned
+     * storage, so the tree no longer depends on any outside buffer.
+     */
+    inline void deep_own();
+
+    /** Turn every borrowed string in the tree that lies inside buffer,
+     * including map keys, into a slice holding a reference to it, so the tree
+     * keeps the buffer alive.
+     */
+    inline void share(const SharedBuffer &buffer);
+
+    /** The integer held, if this is a Positive or Negative that fits.
+     */
+    inline std::optional<std::int64_t> as_int64() const noexcept {
+        if (const auto positive = std::get_if<Positive>(&value_)) {
+            if (positive->is_valid_int64()) {
+                return static_cast<std::int64_t>(*positive);
             }
-            return {begin, Value(Array(std::move(array)))};
-        }
-        case MajorType::Map: {
-            std::map<ValuePointer, ValuePointer> map;
-            const auto count = header.get_count();
-            if (count) {
-                Value key(Undefined{});
-                Value value(Undefined{});
-                for (uint64_t i = 0; i < *count; ++i) {
-                    std::tie(begin, key) = Value::decode(begin, end);
-                    std::tie(begin, value) = Value::decode(begin, end);
-                    map.insert(std::make_pair(
-                      std::make_unique<Value>(std::move(key)),
-                      std::make_unique<Value>(std::move(value))));
-                }
-            } else {
-                Value key(Undefined{});
-                Value value(Undefined{});
-                std::tie(begin, key) = Value::decode(begin, end);
-                for (; key != Value(Break{}); std::tie(begin, key) = Value::decode(begin, end)) {
-                    std::tie(begin, value) = Value::decode(begin, end);
-                    map.insert(std::make_pair(
-                      std::make_unique<Value>(std::move(key)),
-                      std::make_unique<Value>(std::move(value))));
-                }
+        } else if (const auto negative = std::get_if<Negative>(&value_)) {
+            if (negative->is_valid_int64()) {
+                return static_cast<std::int64_t>(*negative);
             }
-            return {begin, Value(Map(std::move(map)))};
-        }
-        case MajorType::SemanticTag: {
-            const auto count = header.get_count().value();
-            Value value(Undefined{});
-            std::tie(begin, value) = Value::decode(begin, end);
-            return {begin, Value(SemanticTag(count, std::make_unique<Value>(std::move(value))))};
-        }
-        case MajorType::SpecialFloat: {
-            switch (header.count.index()) {
-            case 0: {
-                switch (std::get<0>(header.count)) {
-                case 20:
-                    return {begin, Value(Boolean(false))};
-                case 21:
-                    return {begin, Value(Boolean(true))};
-                case 22:
-                    return {begin, Value(Null{})};
-                case 23:
-                    return {begin, Value(Undefined{})};
-                case 31:
-                    return {begin, Value(Break{})};
-                default:
-                    throw IllegalSpecialFloat(
-                      "Illegal special float tiny header count " +
-                      std::to_string(std::get<0>(header.count)));
+        }
+        return std::nullopt;
+    }
+
+    /** The integer held, if this is a Positive.
+     */
+    inline std::optional<std::uint64_t> as_uint64() const noexcept {
+        if (const auto positive = std::get_if<Positive>(&value_)) {
+            return positive->value;
+        }
+        return std::nullopt;
+    }
+
+    /** The number held, if this is a Float.
+     */
+    inline std::optional<double> as_double() const noexcept {
+        if (const auto number = std::get_if<Float>(&value_)) {
+            return number->value;
+        }
+        return std::nullopt;
+    }
+
+    inline std::optional<bool> as_bool() const noexcept {
+        if (const auto boolean = std::get_if<Boolean>(&value_)) {
+            return boolean->value;
+        }
+        return std::nullopt;
+    }
+
+    /** A view of the text held, if this is a Utf8String.
+     */
+    inline std::optional<std::u8string_view> as_string() const noexcept {
+        if (const auto string = std::get_if<Utf8String>(&value_)) {
+            return static_cast<std::u8string_view>(*string);
+        }
+        return std::nullopt;
+    }
+
+    /** A view of the bytes held, if this is a ByteString.
+     */
+    inline std::optional<std::span<const std::byte>> as_bytes() const noexcept {
+        if (const auto string = std::get_if<ByteString>(&value_)) {
+            return static_cast<std::span<const std::byte>>(*string);
+        }
+        return std::nullopt;
+    }
+
+    /** The elements, if this is an Array, or nullptr.
+     */
+    inline const std::vector<ValuePointer> *as_array() const noexcept {
+        if (const auto array = std::get_if<Array>(&value_)) {
+            return &array->value;
+        }
+        return nullptr;
+    }
+
+    /** The entries, if this is a Map, or nullptr.  OrderedMap and IntMap are
+     * available through std::get_if.
+     */
+    inline const std::map<ValuePointer, ValuePointer, std::less<>> *as_map() const noexcept {
+        if (const auto map = std::get_if<Map>(&value_)) {
+            return &map->value;
+        }
+        return nullptr;
+    }
+
+    /** The shared Undefined returned by operator[] when nothing is found.
+     * Compare addresses to tell a miss from a stored Undefined.
+     */
+    static inline const Value &missing() noexcept {
+        static const Value value;
+        return value;
+    }
+
+    /** The element at index in an Array, or the entry under the integer key
+     * in any of the map forms.  Returns missing() rather than throwing, so
+     * lookups can be chained.
+     */
+    template <detail::Integer T>
+    inline const Value &operator[](const T index) const noexcept {
+        if (const auto array = std::get_if<Array>(&value_)) {
+            if constexpr (std::is_signed_v<T>) {
+                if (index < 0) {
+                    return missing();
                 }
             }
-            case 1:
-                throw IllegalSpecialFloat(
-                  "Illegal special float single-byte header value " +
-                  std::to_string(std::get<1>(header.count)));
-            case 2:
-                return {begin, Value(Float(read_float16(to_be_bytes(std::get<2>(header.count)))))};
-            case 3:
-                return {
-                  begin,
-                  Value(Float(from_be_bytes<float>(to_be_bytes(std::get<3>(header.count)))))};
-            case 4:
-                return {
-                  begin,
-                  Value(Float(from_be_bytes<double>(to_be_bytes(std::get<4>(header.count)))))};
-            default:
-                VARBOR_UNREACHABLE;
+            if (static_cast<std::uint64_t>(index) < array->value.size()) {
+                return *array->value[static_cast<std::size_t>(index)];
             }
-            break;
-        }
-        default: {
-            throw std::runtime_error("Illegal major type");
-        }
+            return missing();
         }
+        using Key = std::conditional_t<std::is_signed_v<T>, std::int64_t, std::uint64_t>;
+        return find(Value(static_cast<Key>(index)));
+    }
+
+    /** The entry under a text key in any of the map forms, or missing().
+     * The key is looked up as a view, without allocating.
+     */
+    inline const Value &operator[](const std::u8string_view key) const noexcept {
+        return find(Value(Utf8String(key)));
     }
 
+    template <typename Policy = DecodePolicy, typename InputIt>
+    static inline std::tuple<InputIt, Value> decode(InputIt begin, const InputIt end);
+
+    template <typename Policy = DecodePolicy>
     static inline Value decode(const std::span<const std::byte> bytes) {
-        return std::get<1>(decode(std::begin(bytes), std::end(bytes)));
+        return std::get<1>(decode<Policy>(std::begin(bytes), std::end(bytes)));
     }
 
+    template <typename Policy = DecodePolicy>
     static inline Value decode(const std::vector<std::byte> &bytes) {
-        return decode(std::span<const std::byte>{bytes.data(), bytes.size()});
+        return decode<Policy>(std::span<const std::byte>{bytes.data(), bytes.size()});
+    }
+
+    /** Decode without copying strings or embedded CBOR: each one becomes a
+     * slice of buffer, holding a reference to it.  The result may outlive
+     * every other handle to the buffer, and move between threads.
+     */
+    template <typename Policy = DecodePolicy>
+    static inline Value decode(const SharedBuffer &buffer);
+
+    // std::variant's own equality measured faster than a switch here.  Layouts
+    // of the same kind, such as a Map and an IntMap, are equal when they hold
+    // the same entries.
+    inline bool operator==(const Value &other) const noexcept {
+        if (value_.index() == other.value_.index()) {
+            return value_ == other.value_;
+        }
+        return detail::kind(value_.index()) == detail::kind(other.value_.index()) &&
+          std::is_eq(*this <=> other);
+    }
+
+    inline std::strong_ordering operator<=>(const Value &other) const noexcept {
+        if (value_.index() != other.value_.index()) {
+            const auto kind = detail::kind(value_.index());
+            const auto other_kind = detail::kind(other.value_.index());
+            if (kind != other_kind) {
+                return kind <=> other_kind;
+            }
+            return detail::visit(other.value_, [this](const auto &alternative) {
+                return compare_layout(alternative);
+            });
+        }
+        return detail::visit(value_, [&other](const auto &value) -> std::strong_ordering {
+            using Alternative = std::remove_cvref_t<decltype(value)>;
+            return value <=> *std::get_if<Alternative>(&other.value_);
+        });
+    }
+
+    /** Compare with a native value or a single alternative, with the same
+     * result as converting it to a Value first, but without building one.
+     * Strings are compared as views, so value == u8"ok" does not allocate.
+     */
+    template <detail::Comparable T>
+    inline bool operator==(const T &other) const noexcept {
+        return detail::with_alternative(other, [this](const auto &alternative) {
+            using Alternative = std::remove_cvref_t<decltype(alternative)>;
+            if (const auto held = std::get_if<Alternative>(&value_)) {
+                return *held == alternative;
+            }
+            return detail::kind(value_.index()) ==
+              detail::kind(detail::variant_index<Alternative, Variant>::value) &&
+              std::is_eq(compare_layout(alternative));
+        });
+    }
+
+    template <detail::Comparable T>
+    inline std::strong_ordering operator<=>(const T &other) const noexcept {
+        return detail::with_alternative(
+          other,
+          [this](const auto &alternative) -> std::strong_ordering {
+              using Alternative = std::remove_cvref_t<decltype(alternative)>;
+              if (const auto held = std::get_if<Alternative>(&value_)) {
+                  return *held <=> alternative;
+              }
+              const auto kind = detail::kind(value_.index());
+              const auto other_kind = detail::kind(detail::variant_index<Alternative, Variant>::value);
+              if (kind != other_kind) {
+                  return kind <=> other_kind;
+              }
+              return compare_layout(alternative);
+          });
     }
 
-    bool operator==(const Value &other) const noexcept = default;
-    auto operator<=>(const Value &other) const noexcept = default;
+  private:
+    inline const Value &find(const Value &key) const noexcept;
+
+    /** Order this against an alternative of the same kind held in another
+     * layout, such as a Map against an IntMap or a SemanticTag against a
+     * DateTime, by the items they encode to.
+     */
+    template <detail::Alternative A>
+    inline std::strong_ordering compare_layout(const A &other) const noexcept;
 };
 
 inline bool ValuePointer::operator==(const ValuePointer &other) const noexcept {
@@ -1172,10 +1986,43 @@ inline bool ValuePointer::operator==(const ValuePointer &other) const noexcept {
 inline std::strong_ordering ValuePointer::operator<=>(const ValuePointer &other) const noexcept {
     return *value <=> *other.value;
 }
+inline bool ValuePointer::operator==(const Value &other) const noexcept {
+    return *value == other;
+}
+inline std::strong_ordering ValuePointer::operator<=>(const Value &other) const noexcept {
+    return *value <=> other;
+}
+
+namespace detail {
+/** An output iterator that wants to hear about each node encoded through it,
+ * like Instrumented::Output.
+ */
+template <typename OutputIt>
+concept InstrumentedOutput = requires(OutputIt output, const std::size_t index) {
+    output.enter(index);
+    output.leave();
+};
+} // namespace detail
+
+template <typename OutputIt>
+OutputIt Value::encode(OutputIt output) const {
+    if constexpr (detail::InstrumentedOutput<OutputIt>) {
+        output.enter(value_.index());
+        output = detail::visit(value_, [output](const auto &value) {
+            return value.encode(output);
+        });
+        output.leave();
+        return output;
+    } else {
+        return detail::visit(value_, [output](const auto &value) {
+            return value.encode(output);
+        });
+    }
+}
 
 template <typename OutputIt>
 OutputIt Array::encode(OutputIt output) const {
-    output = write_header(output, Header(MajorType::Array, value.size()));
+    output = write_header(output, MajorType::Array, value.size());
     for (const auto &item : value) {
         output = item->encode(output);
     }
@@ -1184,16 +2031,713 @@ OutputIt Array::encode(OutputIt output) const {
 
 template <typename OutputIt>
 inline OutputIt Map::encode(OutputIt output) const {
-    output = write_header(output, Header(MajorType::Map, value.size()));
+    output = write_header(output, MajorType::Map, value.size());
     for (const auto &[key, val] : value) {
         output = key->encode(output);
         output = val->encode(output);
     }
     return output;
 }
+
+template <class... Args>
+inline Value &Array::emplace_back(Args &&...args) {
+    return *value.emplace_back(std::make_unique<Value>(std::forward<Args>(args)...));
+}
+
+template <class... Args>
+inline Array Array::of(Args &&...elements) {
+    Array array;
+    array.value.reserve(sizeof...(elements));
+    (array.emplace_back(std::forward<Args>(elements)), ...);
+    return array;
+}
+
+template <typename K, class... Args>
+inline std::pair<Map::iterator, bool> Map::try_emplace(K &&key, Args &&...args) {
+    Value built(std::forward<K>(key));
+    auto found = value.end();
+    if (!value.empty()) {
+        const auto last = std::prev(value.end());
+        const auto order = built <=> *last->first;
+        if (order == 0) {
+            return {last, false};
+        } else if (order < 0) {
+            found = value.lower_bound(built);
+            if (found->first == built) {
+                return {found, false};
+            }
+        }
+    }
+    return {
+      value.emplace_hint(
+        found,
+        std::make_unique<Value>(std::move(built)),
+        std::make_unique<Value>(std::forward<Args>(args)...)),
+      true};
+}
+
+inline bool Map::append(ValuePointer key, ValuePointer val) {
+    if (!value.empty()) {
+        const auto last = std::prev(value.end());
+        const auto order = *key <=> *last->first;
+        if (order <= 0) {
+            const auto found = order == 0 ? last : value.lower_bound(*key);
+            if (order == 0 || found->first == *key) {
+                found->second = std::move(val);
+                return false;
+            }
+            value.emplace_hint(found, std::move(key), std::move(val));
+            return true;
+        }
+    }
+    value.emplace_hint(value.end(), std::move(key), std::move(val));
+    return true;
+}
+
+inline Map Map::from_sorted(std::vector<std::pair<ValuePointer, ValuePointer>> entries) {
+    Map map;
+    for (auto &[key, val] : entries) {
+        map.append(std::move(key), std::move(val));
+    }
+    return map;
+}
+
+inline Map Map::merge(std::vector<Map> maps) {
+    // A heap of the maps with entries left, by their smallest key, with the
+    // latest map first among equal keys, so its value is the one kept.
+    std::vector<std::size_t> heads;
+    for (std::size_t i = 0; i < maps.size(); ++i) {
+        if (!maps[i].value.empty()) {
+            heads.push_back(i);
+        }
+    }
+    const auto later = [&maps](const std::size_t a, const std::size_t b) {
+        const auto order = *maps[a].value.begin()->first <=> *maps[b].value.begin()->first;
+        return order > 0 || (order == 0 && a < b);
+    };
+    std::make_heap(heads.begin(), heads.end(), later);
+
+    Map output;
+    while (!heads.empty()) {
+        std::pop_heap(heads.begin(), heads.end(), later);
+        auto &source = maps[heads.back()].value;
+        auto node = source.extract(source.begin());
+        if (output.value.empty() || *std::prev(output.value.end())->first != *node.key()) {
+            output.value.insert(output.value.end(), std::move(node));
+        }
+        if (source.empty()) {
+            heads.pop_back();
+        } else {
+            std::push_heap(heads.begin(), heads.end(), later);
+        }
+    }
+    return output;
+}
+
+template <typename OutputIt>
+inline OutputIt OrderedMap::encode(OutputIt output) const {
+    output = write_header(output, MajorType::Map, value.size());
+    for (const auto &[key, val] : value) {
+        output = key->encode(output);
+        output = val->encode(output);
+    }
+    return output;
+}
+
+inline void OrderedMap::build_index() {
+    if (!index_ || index_->indexed > value.size()) {
+        index_ = std::make_unique<Index>();
+    }
+    for (; index_->indexed < value.size(); ++index_->indexed) {
+        index_->entries.emplace(value[index_->indexed].first->hash(), index_->indexed);
+    }
+}
+
+inline std::size_t OrderedMap::find_index(const Value &key) const {
+    std::size_t scanned = 0;
+    // An index covering more entries than remain is left from before a
+    // removal, and ignored.
+    if (index_ && index_->indexed <= value.size()) {
+        std::size_t found = value.size();
+        const auto [first, last] = index_->entries.equal_range(key.hash());
+        for (auto it = first; it != last; ++it) {
+            if (it->second < found && *value[it->second].first == key) {
+                found = it->second;
+            }
+        }
+        if (found != value.size()) {
+            return found;
+        }
+        scanned = index_->indexed;
+    }
+    for (std::size_t i = scanned; i < value.size(); ++i) {
+        if (*value[i].first == key) {
+            return i;
+        }
+    }
+    return value.size();
+}
+
+inline std::vector<std::pair<ValuePointer, ValuePointer>>::iterator OrderedMap::find(
+  const Value &key) {
+    if (value.size() >= index_threshold) {
+        build_index();
+    }
+    return value.begin() + find_index(key);
+}
+
+inline std::vector<std::pair<ValuePointer, ValuePointer>>::const_iterator OrderedMap::find(
+  const Value &key) const {
+    return value.begin() + find_index(key);
+}
+
+inline std::vector<std::size_t> OrderedMap::duplicates() const {
+    std::vector<std::size_t> output;
+    std::unordered_multimap<std::uint64_t, std::size_t> seen;
+    seen.reserve(value.size());
+    for (std::size_t i = 0; i < value.size(); ++i) {
+        const auto hash = value[i].first->hash();
+        const auto [first, last] = seen.equal_range(hash);
+        if (std::any_of(first, last, [&](const auto &entry) {
+                return *value[entry.second].first == *value[i].first;
+            })) {
+            output.push_back(i);
+        } else {
+            seen.emplace(hash, i);
+        }
+    }
+    return output;
+}
+
+inline std::optional<std::size_t> IntMap::slot(const Value &key) noexcept {
+    if (const auto positive = std::get_if<Positive>(&key.value())) {
+        if (positive->value <= static_cast<std::uint64_t>(max_key)) {
+            return slot(static_cast<std::int64_t>(positive->value));
+        }
+    } else if (const auto negative = std::get_if<Negative>(&key.value())) {
+        if (negative->count < static_cast<std::uint64_t>(-min_key)) {
+            return slot(static_cast<std::int64_t>(*negative));
+        }
+    }
+    return std::nullopt;
+}
+
+template <typename F>
+inline void Value::each_string(const F &f) {
+    const auto entries = [&f](auto &entries) {
+        for (auto &[key, value] : entries) {
+            // Owning or sharing changes neither a key's encoding nor its
+            // order, so a const map key can be rewritten in place.
+            const_cast<Value &>(*key).each_string(f);
+            value->each_string(f);
+        }
+    };
+    detail::visit(value_, [&f, &entries](auto &node) {
+        using T = std::remove_cvref_t<decltype(node)>;
+        if constexpr (
+          std::same_as<T, ByteString> || std::same_as<T, Utf8String> ||
+          std::same_as<T, EmbeddedCbor>) {
+            f(node);
+        } else if constexpr (std::same_as<T, Array>) {
+            for (auto &item : node.value) {
+                item->each_string(f);
+            }
+        } else if constexpr (std::same_as<T, Map> || std::same_as<T, OrderedMap>) {
+            entries(node.value);
+        } else if constexpr (std::same_as<T, IntMap>) {
+            for (auto &slot : node.slots) {
+                if (static_cast<const std::unique_ptr<Value> &>(slot)) {
+                    slot->each_string(f);
+                }
+            }
+            entries(node.rest.value);
+        } else if constexpr (std::same_as<T, SemanticTag>) {
+            node.value->each_string(f);
+        }
+    });
+}
+
+inline void Value::deep_own() {
+    each_string([](auto &string) {
+        string.own();
+    });
+}
+
+inline void Value::share(const SharedBuffer &buffer) {
+    each_string([&buffer](auto &string) {
+        string.share(buffer);
+    });
+}
+
+inline const Value &Value::find(const Value &key) const noexcept {
+    if (const auto map = std::get_if<Map>(&value_)) {
+        const auto found = map->value.find(key);
+        return found == map->value.end() ? missing() : *found->second;
+    } else if (const auto map = std::get_if<OrderedMap>(&value_)) {
+        const auto found = map->find(key);
+        return found == map->value.end() ? missing() : *found->second;
+    } else if (const auto map = std::get_if<IntMap>(&value_)) {
+        const auto found = map->find(key);
+        return found == nullptr ? missing() : *found;
+    }
+    return missing();
+}
+
+inline Value *IntMap::find(const std::int64_t key) {
+    return const_cast<Value *>(static_cast<const IntMap &>(*this).find(key));
+}
+
+inline const Value *IntMap::find(const std::int64_t key) const {
+    if (const auto index = slot(key)) {
+        if (*index < slots.size()) {
+            return static_cast<const std::unique_ptr<Value> &>(slots[*index]).get();
+        }
+        return nullptr;
+    }
+    return find(Value(key));
+}
+
+inline Value *IntMap::find(const Value &key) {
+    return const_cast<Value *>(static_cast<const IntMap &>(*this).find(key));
+}
+
+inline const Value *IntMap::find(const Value &key) const {
+    if (const auto index = slot(key)) {
+        return find(IntMap::key(*index));
+    }
+    const auto found = rest.value.find(key);
+    return found == rest.value.end() ? nullptr : &*found->second;
+}
+
+inline bool IntMap::insert(Value key, Value value) {
+    if (const auto index = slot(key)) {
+        if (*index >= slots.size()) {
+            slots.resize(*index + 1);
+        }
+        auto &slot = static_cast<std::unique_ptr<Value> &>(slots[*index]);
+        if (slot) {
+            return false;
+        }
+        slot = std::make_unique<Value>(std::move(value));
+        return true;
+    }
+    return rest.value
+      .insert(std::make_pair(
+        std::make_unique<Value>(std::move(key)),
+        std::make_unique<Value>(std::move(value))))
+      .second;
+}
+
+template <typename F>
+inline void IntMap::for_each(F &&f) const {
+    // Value ordering puts every positive before every negative, so walk the
+    // even slots upward and then the odd ones, merging in the other keys.
+    auto other = rest.value.begin();
+    const auto visit_slot = [&](const std::size_t index) {
+        const auto &value = static_cast<const std::unique_ptr<Value> &>(slots[index]);
+        if (!value) {
+            return;
+        }
+        const Value key(IntMap::key(index));
+        for (; other != rest.value.end() && *other->first < key; ++other) {
+            f(*other->first, *other->second);
+        }
+        f(key, *value);
+    };
+    for (std::size_t index = 0; index < slots.size(); index += 2) {
+        visit_slot(index);
+    }
+    for (std::size_t index = 1; index < slots.size(); index += 2) {
+        visit_slot(index);
+    }
+    for (; other != rest.value.end(); ++other) {
+        f(*other->first, *other->second);
+    }
+}
+
+template <typename OutputIt>
+inline OutputIt IntMap::encode(OutputIt output) const {
+    output = write_header(output, MajorType::Map, size());
+    for_each([&output](const Value &key, const Value &value) {
+        output = key.encode(output);
+        output = value.encode(output);
+    });
+    return output;
+}
+
+inline bool IntMap::operator==(const IntMap &other) const noexcept {
+    for (std::size_t i = 0; i < std::max(slots.size(), other.slots.size()); ++i) {
+        const Value *const lhs =
+          i < slots.size() ? static_cast<const std::unique_ptr<Value> &>(slots[i]).get() : nullptr;
+        const Value *const rhs = i < other.slots.size()
+          ? static_cast<const std::unique_ptr<Value> &>(other.slots[i]).get()
+          : nullptr;
+        if ((lhs == nullptr) != (rhs == nullptr) || (lhs && *lhs != *rhs)) {
+            return false;
+        }
+    }
+    return rest == other.rest;
+}
+
+namespace detail {
+/** Steps through the entries of any map layout in encoding order, one at a
+ * time and without allocating, so layouts can be compared entry by entry.
+ * An OrderedMap encodes, and so walks, in wire order.
+ */
+class MapWalk {
+  private:
+    using Entries = std::map<ValuePointer, ValuePointer, std::less<>>;
+    using Ordered = std::vector<std::pair<ValuePointer, ValuePointer>>;
+
+    const Ordered *ordered_ = nullptr;
+    Ordered::const_iterator entry_;
+    const IntMap *int_map_ = nullptr;
+    // A Map's entries, or an IntMap's other keys.
+    const Entries *entries_ = nullptr;
+    Entries::const_iterator other_;
+    // The next IntMap slot, taking the even slots upward and then the odd ones.
+    std::size_t slot_ = 0;
+    // The key of that slot, built on the stack.
+    Value small_;
+    std::size_t size_ = 0;
+
+    inline void settle() noexcept {
+        const auto &slots = int_map_->slots;
+        while (true) {
+            if (slot_ >= slots.size()) {
+                if (slot_ % 2 == 1) {
+                    return;
+                }
+                slot_ = 1;
+            } else if (static_cast<const std::unique_ptr<Value> &>(slots[slot_])) {
+                small_ = Value(IntMap::key(slot_));
+                return;
+            } else {
+                slot_ += 2;
+            }
+        }
+    }
+
+    // Whether the current entry is an IntMap slot rather than one of the others.
+    inline bool on_slot() const noexcept {
+        return int_map_ && slot_ < int_map_->slots.size() &&
+          (other_ == entries_->end() || !(*other_->first < small_));
+    }
+
+  public:
+    inline explicit MapWalk(const Map &map) noexcept :
+        entries_(&map.value),
+        other_(map.value.begin()),
+        size_(map.value.size()) {
+    }
+
+    inline explicit MapWalk(const OrderedMap &map) noexcept :
+        ordered_(&map.value),
+        entry_(map.value.begin()),
+        size_(map.value.size()) {
+    }
+
+    inline explicit MapWalk(const IntMap &map) noexcept :
+        int_map_(&map),
+        entries_(&map.rest.value),
+        other_(map.rest.value.begin()),
+        size_(map.size()) {
+        settle();
+    }
+
+    /** Walk the map held by value, which must be a MapLayout.
+     */
+    inline explicit MapWalk(const Value &value) noexcept {
+        if (const auto map = std::get_if<Map>(&value.value())) {
+            entries_ = &map->value;
+            other_ = map->value.begin();
+            size_ = map->value.size();
+        } else if (const auto ordered = std::get_if<OrderedMap>(&value.value())) {
+            ordered_ = &ordered->value;
+            entry_ = ordered->value.begin();
+            size_ = ordered->value.size();
+        } else {
+            const auto &int_map = *std::get_if<IntMap>(&value.value());
+            int_map_ = &int_map;
+            entries_ = &int_map.rest.value;
+            other_ = int_map.rest.value.begin();
+            size_ = int_map.size();
+            settle();
+        }
+    }
+
+    inline std::size_t size() const noexcept {
+        return size_;
+    }
+
+    inline const Value &key() const noexcept {
+        if (ordered_) {
+            return *entry_->first;
+        }
+        return on_slot() ? small_ : *other_->first;
+    }
+
+    inline const Value &value() const noexcept {
+        if (ordered_) {
+            return *entry_->second;
+        }
+        return on_slot() ? *static_cast<const std::unique_ptr<Value> &>(int_map_->slots[slot_])
+                         : *other_->second;
+    }
+
+    inline void next() noexcept {
+        if (ordered_) {
+            ++entry_;
+        } else if (on_slot()) {
+            slot_ += 2;
+            settle();
+        } else {
+            ++other_;
+        }
+    }
+};
+
+/** Order two maps, in any layouts, as Map orders: by size, and then entry by
+ * entry in encoding order.
+ */
+inline std::strong_ordering compare_maps(MapWalk lhs, MapWalk rhs) noexcept {
+    const auto size_compare = lhs.size() <=> rhs.size();
+    if (size_compare != std::strong_ordering::equal) {
+        return size_compare;
+    }
+    for (std::size_t i = lhs.size(); i > 0; --i) {
+        const auto key_compare = lhs.key() <=> rhs.key();
+        if (key_compare != std::strong_ordering::equal) {
+            return key_compare;
+        }
+        const auto value_compare = lhs.value() <=> rhs.value();
+        if (value_compare != std::strong_ordering::equal) {
+            return value_compare;
+        }
+        lhs.next();
+        rhs.next();
+    }
+    return std::strong_ordering::equal;
+}
+} // namespace detail
+
+inline std::strong_ordering IntMap::operator<=>(const IntMap &other) const noexcept {
+    return detail::compare_maps(detail::MapWalk(*this), detail::MapWalk(other));
+}
+
+namespace detail {
+/** Room for the longest time format_rfc3339 writes.
+ */
+using Rfc3339Buffer = std::array<char8_t, 35>;
+
+/** Format a time, in nanoseconds since the epoch, as RFC 3339 with the given
+ * UTC offset in minutes, with only as many fractional digits as needed.  The
+ * text is written into buffer, so formatting never allocates.
+ */
+inline std::u8string_view format_rfc3339(
+  Rfc3339Buffer &buffer,
+  const std::int64_t nanoseconds,
+  const std::int32_t offset_minutes) noexcept {
+    constexpr std::int64_t second = 1000000000;
+    constexpr std::int64_t day = 86400;
+    // Floor division, so times before the epoch count back from midnight.
+    const auto floor_div = [](const std::int64_t value, const std::int64_t divisor) {
+        return value / divisor - (value % divisor < 0 ? 1 : 0);
+    };
+    const auto local = nanoseconds + std::int64_t{offset_minutes} * 60 * second;
+    const auto seconds = floor_div(local, second);
+    const auto fraction_part = local - seconds * second;
+    const auto days = floor_div(seconds, day);
+    const auto clock = seconds - days * day;
+
+    // Days since the epoch to a civil date, after Howard Hinnant's
+    // civil_from_days.
+    const auto shifted = days + 719468;
+    const auto era = floor_div(shifted, 146097);
+    const auto day_of_era = shifted - era * 146097;
+    const auto year_of_era =
+      (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    const auto day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    const auto shifted_month = (5 * day_of_year + 2) / 153;
+    const auto month = shifted_month < 10 ? shifted_month + 3 : shifted_month - 9;
+    const auto year = year_of_era + era * 400 + (month <= 2 ? 1 : 0);
+
+    std::size_t size = 0;
+    const auto push = [&buffer, &size](const char8_t c) {
+        buffer[size++] = c;
+    };
+    const auto digits = [&buffer, &size](std::int64_t value, const std::size_t count) {
+        size += count;
+        for (std::size_t i = 0; i < count; ++i) {
+            buffer[size - 1 - i] = static_cast<char8_t>(u8'0' + value % 10);
+            value /= 10;
+        }
+    };
+    digits(year, 4);
+    push(u8'-');
+    digits(month, 2);
+    push(u8'-');
+    digits(day_of_year - (153 * shifted_month + 2) / 5 + 1, 2);
+    push(u8'T');
+    digits(clock / 3600, 2);
+    push(u8':');
+    digits(clock / 60 % 60, 2);
+    push(u8':');
+    digits(clock % 60, 2);
+
+    auto fraction = fraction_part;
+    if (fraction != 0) {
+        std::size_t width = 9;
+        for (; fraction % 10 == 0; fraction /= 10) {
+            --width;
+        }
+        push(u8'.');
+        digits(fraction, width);
+    }
+
+    if (offset_minutes == 0) {
+        push(u8'Z');
+    } else {
+        const auto magnitude = offset_minutes < 0 ? -std::int64_t{offset_minutes} : offset_minutes;
+        push(offset_minutes < 0 ? u8'-' : u8'+');
+        digits(magnitude / 60, 2);
+        push(u8':');
+        digits(magnitude % 60, 2);
+    }
+    return std::u8string_view(buffer.data(), size);
+}
+} // namespace detail
+
+template <typename OutputIt>
+OutputIt DateTime::encode(OutputIt output) const {
+    output = write_header(output, MajorType::SemanticTag, id);
+    if (id == 0) {
+        detail::Rfc3339Buffer buffer;
+        const auto text = detail::format_rfc3339(buffer, nanoseconds, offset_minutes);
+        output = write_header(output, MajorType::Utf8String, text.size());
+        return std::ranges::copy(std::as_bytes(std::span(text)), output).out;
+    }
+    if (nanoseconds % 1000000000 == 0) {
+        return write_integer(output, nanoseconds / 1000000000);
+    }
+    return Float(static_cast<double>(nanoseconds) / 1e9).encode(output);
+}
+
+inline EmbeddedCbor EmbeddedCbor::wrap(const Value &value) {
+    return EmbeddedCbor{ByteString(value.encode())};
+}
+
 template <typename OutputIt>
 OutputIt SemanticTag::encode(OutputIt output) const {
-    output = write_header(output, Header(MajorType::SemanticTag, id));
+    output = write_header(output, MajorType::SemanticTag, id);
     return value->encode(output);
 }
+
+namespace detail {
+inline std::uint64_t tag_id(const SemanticTag &tag) noexcept {
+    return tag.id;
+}
+
+inline std::uint64_t tag_id(const DateTime &time) noexcept {
+    return time.id;
+}
+
+inline std::uint64_t tag_id(const BigNum &number) noexcept {
+    return number.negative ? 3 : 2;
+}
+
+inline std::uint64_t tag_id(const DecimalFraction &fraction) noexcept {
+    return fraction.id;
+}
+
+inline std::uint64_t tag_id(const Uuid &) noexcept {
+    return 37;
+}
+
+inline std::uint64_t tag_id(const EmbeddedCbor &) noexcept {
+    return 24;
+}
+
+/** Order an item against a typed tag node by their encodings.  The node is
+ * encoded on the stack, and the item streamed against it, so nothing is
+ * allocated.
+ */
+template <typename T, BoundedTag Bounded>
+inline std::strong_ordering compare_encoded(const T &lhs, const Bounded &rhs) noexcept {
+    std::array<std::byte, 64> buffer;
+    const auto end = rhs.encode(buffer.data());
+    return lhs.encode(ComparingIterator(std::span<const std::byte>(buffer.data(), end))).order();
+}
+
+/** Order two tags of different layouts as the tag and payload they encode
+ * to.  Typed nodes claim distinct ids, so only a generic SemanticTag ever
+ * shares an id with one, and then the payloads decide.
+ */
+template <TagLayout L, TagLayout R>
+inline std::strong_ordering compare_tags(const L &lhs, const R &rhs) noexcept {
+    const auto id_compare = tag_id(lhs) <=> tag_id(rhs);
+    if (id_compare != std::strong_ordering::equal) {
+        return id_compare;
+    }
+    if constexpr (BoundedTag<R>) {
+        return compare_encoded(lhs, rhs);
+    } else if constexpr (BoundedTag<L>) {
+        return 0 <=> compare_encoded(rhs, lhs);
+    } else if constexpr (std::same_as<L, SemanticTag> && std::same_as<R, EmbeddedCbor>) {
+        return *lhs.value <=> rhs.bytes;
+    } else if constexpr (std::same_as<L, EmbeddedCbor> && std::same_as<R, SemanticTag>) {
+        return 0 <=> (*rhs.value <=> lhs.bytes);
+    } else {
+        return lhs <=> rhs;
+    }
+}
+} // namespace detail
+
+inline bool DateTime::operator==(const DateTime &other) const noexcept {
+    return std::is_eq(*this <=> other);
+}
+
+inline std::strong_ordering DateTime::operator<=>(const DateTime &other) const noexcept {
+    return detail::compare_encoded(*this, other);
+}
+
+inline std::strong_ordering DecimalFraction::operator<=>(
+  const DecimalFraction &other) const noexcept {
+    return detail::compare_encoded(*this, other);
+}
+
+template <detail::Alternative A>
+inline std::strong_ordering Value::compare_layout(const A &other) const noexcept {
+    if constexpr (detail::MapLayout<A>) {
+        return detail::compare_maps(detail::MapWalk(*this), detail::MapWalk(other));
+    } else if constexpr (detail::TagLayout<A>) {
+        return detail::visit(value_, [&other](const auto &value) -> std::strong_ordering {
+            using Alternative = std::remove_cvref_t<decltype(value)>;
+            if constexpr (detail::TagLayout<Alternative>) {
+                return detail::compare_tags(value, other);
+            } else {
+                VARBOR_UNREACHABLE;
+            }
+        });
+    } else {
+        // Every other alternative is a kind of its own.
+        VARBOR_UNREACHABLE;
+    }
+}
+
 } // namespace varbor
+
+template <>
+struct std::hash<varbor::Value> {
+    inline std::size_t operator()(const varbor::Value &value) const {
+        return static_cast<std::size_t>(value.hash());
+    }
+};
+
+// Decoding lives in its own header, which every user of Value::decode gets
+// through this one.
+#include <varbor/decode.hxx>
+
+#ifdef VARBOR_COMPILED
+#include <varbor/compiled.hxx>
+#endif
@@ -0,0 +1,31 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+#pragma once
+
+// Explicit instantiations shared with varbor::varbor_compiled.  varbor.hxx
+// includes this when VARBOR_COMPILED is defined, and src/varbor.cxx to
+// instantiate it.
+#include <varbor.hxx>
+
+namespace varbor {
+// The encoders and decoders for the common iterator types, which
+// varbor::varbor_compiled instantiates once for everything linking it.
+#define VARBOR_INSTANTIATIONS(EXTERN)                                                              \
+    EXTERN template class Decoder<DecodePolicy, const std::byte *>;                                \
+    EXTERN template class Decoder<DecodePolicy, std::span<const std::byte>::iterator>;             \
+    EXTERN template class Decoder<DecodePolicy, std::vector<std::byte>::iterator>;                 \
+    EXTERN template class Decoder<DecodePolicy, std::vector<std::byte>::const_iterator>;           \
+    EXTERN template std::byte *Value::encode<std::byte *>(std::byte *) const;                      \
+    EXTERN template std::vector<std::byte>::iterator                                               \
+    Value::encode<std::vector<std::byte>::iterator>(std::vector<std::byte>::iterator) const;       \
+    EXTERN template std::back_insert_iterator<std::vector<std::byte>>                              \
+    Value::encode<std::back_insert_iterator<std::vector<std::byte>>>(                              \
+      std::back_insert_iterator<std::vector<std::byte>>) const;                                    \
+    EXTERN template CountingIterator Value::encode<CountingIterator>(CountingIterator) const;      \
+    EXTERN template HashingIterator Value::encode<HashingIterator>(HashingIterator) const;
+
+#if defined(VARBOR_COMPILED) && !defined(VARBOR_COMPILED_SOURCE)
+VARBOR_INSTANTIATIONS(extern)
+#endif
+} // namespace varbor
@@ -0,0 +1,194 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+#pragma once
+
+#include <varbor.hxx>
+
+#include <mutex>
+#include <shared_mutex>
+
+namespace varbor {
+/** A map for many threads updating a shared document.  Keys are spread over
+ * shards by Value::hash, which agrees with key equality, and every entry has
+ * its own lock, so writers only contend on the same key, and on a shard only
+ * to add or remove keys.  Lookups and updates of existing keys take their
+ * shard's lock shared.
+ *
+ * encode() briefly locks every shard exclusively, and writes a consistent
+ * snapshot with the same bytes as the equivalent Map.
+ */
+class ConcurrentMap {
+  private:
+    struct Entry {
+        mutable std::shared_mutex mutex;
+        Value value;
+    };
+
+    struct Shard {
+        mutable std::shared_mutex mutex;
+        std::map<ValuePointer, std::unique_ptr<Entry>, std::less<>> entries;
+    };
+
+    std::vector<Shard> shards_;
+
+    inline Shard &shard(const Value &key) noexcept {
+        return shards_[key.hash() % shards_.size()];
+    }
+
+    inline const Shard &shard(const Value &key) const noexcept {
+        return shards_[key.hash() % shards_.size()];
+    }
+
+  public:
+    /** Spread keys over shards shards.
+     */
+    inline explicit ConcurrentMap(const std::size_t shards = 16) :
+        shards_(std::max<std::size_t>(shards, 1)) {
+    }
+
+    /** Take over the entries of map.
+     */
+    inline explicit ConcurrentMap(Map map, const std::size_t shards = 16) : ConcurrentMap(shards) {
+        while (!map.value.empty()) {
+            auto node = map.value.extract(map.value.begin());
+            auto &entries = shard(*node.key()).entries;
+            auto entry = std::make_unique<Entry>();
+            entry->value = std::move(*node.mapped());
+            entries.emplace_hint(entries.end(), std::move(node.key()), std::move(entry));
+        }
+    }
+
+    ConcurrentMap(const ConcurrentMap &) = delete;
+    ConcurrentMap &operator=(const ConcurrentMap &) = delete;
+
+    /** The number of entries.  Other threads may change it at any time.
+     */
+    inline std::size_t size() const {
+        std::size_t size = 0;
+        for (const auto &shard : shards_) {
+            const std::shared_lock lock(shard.mutex);
+            size += shard.entries.size();
+        }
+        return size;
+    }
+
+    /** Call f with the value for key under a shared lock, if key exists.
+     * Returns whether it did.  f must not call back into this map.
+     */
+    template <typename F>
+    inline bool read(const Value &key, F &&f) const {
+        const auto &shard = this->shard(key);
+        const std::shared_lock lock(shard.mutex);
+        const auto found = shard.entries.find(key);
+        if (found == shard.entries.end()) {
+            return false;
+        }
+        const std::shared_lock entry_lock(found->second->mutex);
+        std::forward<F>(f)(std::as_const(found->second->value));
+        return true;
+    }
+
+    /** Call f with the value for key under that key's exclusive lock, to
+     * modify it in place.  A missing key is added as Undefined first.  Only
+     * writers to the same key wait for f, except when f runs on a key it just
+     * added, which holds key's shard exclusively so erase() cannot free the
+     * entry in between.
+     *
+     * f runs with key's shard locked, so it must not call back into this
+     * map: adding or erasing a key, or encoding, would deadlock.
+     */
+    template <typename F>
+    inline void update(Value key, F &&f) {
+        auto &shard = this->shard(key);
+        {
+            const std::shared_lock lock(shard.mutex);
+            if (const auto found = shard.entries.find(key); found != shard.entries.end()) {
+                const std::unique_lock entry_lock(found->second->mutex);
+                std::forward<F>(f)(found->second->value);
+                return;
+            }
+        }
+        const std::unique_lock lock(shard.mutex);
+        // Another writer may have added it while unlocked.
+        auto found = shard.entries.lower_bound(key);
+        if (found == shard.entries.end() || *found->first != key) {
+            found = shard.entries.emplace_hint(
+              found,
+              std::make_unique<Value>(std::move(key)),
+              std::make_unique<Entry>());
+        }
+        const std::unique_lock entry_lock(found->second->mutex);
+        std::forward<F>(f)(found->second->value);
+    }
+
+    /** Set key to value.
+     */
+    inline void set(Value key, Value value) {
+        update(std::move(key), [&value](Value &existing) {
+            existing = std::move(value);
+        });
+    }
+
+    /** Remove key.  Returns whether it was present.
+     */
+    inline bool erase(const Value &key) {
+        auto &shard = this->shard(key);
+        const std::unique_lock lock(shard.mutex);
+        const auto found = shard.entries.find(key);
+        if (found == shard.entries.end()) {
+            return false;
+        }
+        shard.entries.erase(found);
+        return true;
+    }
+
+    /** Encode a consistent snapshot, in key order across all shards, exactly
+     * as the equivalent Map.  Every shard is locked, in order, for the
+     * duration.
+     */
+    template <typename OutputIt>
+    OutputIt encode(OutputIt output) const {
+        std::vector<std::unique_lock<std::shared_mutex>> locks;
+        locks.reserve(shards_.size());
+        std::size_t size = 0;
+        for (const auto &shard : shards_) {
+            locks.emplace_back(shard.mutex);
+            size += shard.entries.size();
+        }
+
+        // Merge the sorted shards, smallest key first.
+        using Position = decltype(Shard::entries)::const_iterator;
+        std::vector<std::pair<Position, Position>> heads;
+        for (const auto &shard : shards_) {
+            if (!shard.entries.empty()) {
+                heads.emplace_back(shard.entries.begin(), shard.entries.end());
+            }
+        }
+        const auto later = [](const auto &a, const auto &b) {
+            return *a.first->first > *b.first->first;
+        };
+        std::make_heap(heads.begin(), heads.end(), later);
+
+        output = write_header(output, MajorType::Map, size);
+        while (!heads.empty()) {
+            std::pop_heap(heads.begin(), heads.end(), later);
+            auto &head = heads.back();
+            output = head.first->first->encode(output);
+            output = head.first->second->value.encode(output);
+            if (++head.first == head.second) {
+                heads.pop_back();
+            } else {
+                std::push_heap(heads.begin(), heads.end(), later);
+            }
+        }
+        return output;
+    }
+
+    inline std::vector<std::byte> encode() const {
+        std::vector<std::byte> output;
+        encode(std::back_inserter(output));
+        return output;
+    }
+};
+} // namespace varbor
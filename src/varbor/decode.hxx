@@ -0,0 +1,1089 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+#pragma once
+
+// Reading raw headers, decode policies, and the decoder behind Value::decode.
+// varbor.hxx includes this at its end, so including either one gets both.
+#include <varbor.hxx>
+
+namespace varbor {
+template <typename T>
+inline T from_be_bytes(std::array<std::byte, sizeof(T)> input) {
+    T value;
+    const auto v_pointer = reinterpret_cast<std::byte *>(&value);
+
+    for (size_t i = 0; i < sizeof(value); ++i) {
+        if constexpr (std::endian::native == std::endian::big) {
+            v_pointer[i] = input[i];
+        } else {
+            v_pointer[i] = input[sizeof(value) - 1 - i];
+        }
+    }
+
+    return value;
+}
+
+inline float read_float16(std::array<std::byte, 2> input) {
+    const bool sign = (input[0] & std::byte(0b10000000)) != std::byte(0);
+    const std::uint8_t exponent =
+      static_cast<std::uint8_t>((input[0] & std::byte(0b01111100)) >> 2);
+    const std::uint16_t fraction =
+      (static_cast<std::uint16_t>(input[0] & std::byte(0b00000011)) << 8) |
+      static_cast<std::uint16_t>(input[1]);
+    if (exponent == 0) {
+        // zero
+        if (fraction == 0) {
+            if (sign) {
+                return -0.0f;
+            } else {
+                return 0.0f;
+            }
+        } else {
+            // Subnormal.  There probably is a better way of doing this.
+            const auto adjusted_fraction =
+              static_cast<float>(fraction) / static_cast<float>(1 << 10);
+            return (sign ? -1.0f : 1.0f) * adjusted_fraction * std::pow(2.0f, -14);
+        }
+    } else if (exponent == 0b11111) {
+        // infinity
+        if (fraction == 0) {
+            return (sign ? -1.0f : 1.0f) * std::numeric_limits<float>::infinity();
+        } else {
+            // NaN
+            return std::numeric_limits<float>::quiet_NaN();
+        }
+    } else {
+        const std::int8_t normalized_exponent = static_cast<std::int8_t>(exponent) - 15;
+        const auto biased_exponent =
+          std::byte(static_cast<std::int16_t>(normalized_exponent) + 127);
+
+        std::array<std::byte, 4> bytes = {std::byte(0), std::byte(0), std::byte(0), std::byte(0)};
+
+        if (sign) {
+            bytes[0] = std::byte(0b10000000);
+        }
+        bytes[0] |= biased_exponent >> 1;
+
+        // Left bit is right bit from exponent.
+        bytes[1] = biased_exponent << 7;
+
+        // Most significant 7 bits from 10-bit fraction
+        bytes[1] |= std::byte(fraction >> 3);
+
+        // Least significant 3 bits of 10-bit fraction
+        bytes[2] = std::byte(fraction << 5);
+
+        return from_be_bytes<float>(bytes);
+    }
+}
+
+/** Read a single byte, returning an error if input is empty.
+ */
+template <typename InputIt>
+inline std::tuple<InputIt, std::byte> read(InputIt begin, const InputIt end) {
+    if (begin == end) {
+        throw EndOfInput("Reached end of input early");
+    }
+    const std::byte output = *begin;
+    ++begin;
+    return {begin, output};
+}
+
+template <typename InputIt>
+std::tuple<InputIt, Header> read_header(InputIt begin, const InputIt end) {
+    std::byte byte;
+    std::tie(begin, byte) = read(begin, end);
+    const auto type = static_cast<MajorType>(byte >> 5);
+    const auto tinycount = static_cast<std::uint8_t>(byte & std::byte(0b00011111));
+
+    switch (tinycount) {
+    case 24: {
+        std::tie(begin, byte) = read(begin, end);
+        return {begin, Header{type, Count(std::in_place_index<1>, static_cast<uint8_t>(byte))}};
+    }
+
+    case 25: {
+        std::array<std::byte, 2> count;
+        for (size_t i = 0; i < sizeof(count); ++i) {
+            std::tie(begin, count[i]) = read(begin, end);
+        }
+        return {begin, Header{type, Count(std::in_place_index<2>, from_be_bytes<uint16_t>(count))}};
+    }
+
+    case 26: {
+        std::array<std::byte, 4> count;
+        for (size_t i = 0; i < sizeof(count); ++i) {
+            std::tie(begin, count[i]) = read(begin, end);
+        }
+        return {begin, Header{type, Count(std::in_place_index<3>, from_be_bytes<uint32_t>(count))}};
+    }
+
+    case 27: {
+        std::array<std::byte, 8> count;
+        for (size_t i = 0; i < sizeof(count); ++i) {
+            std::tie(begin, count[i]) = read(begin, end);
+        }
+        return {begin, Header{type, Count(std::in_place_index<4>, from_be_bytes<uint64_t>(count))}};
+    }
+
+    default: {
+        return {begin, Header{type, Count(std::in_place_index<0>, tinycount)}};
+    }
+    }
+}
+
+/** Advance past count raw bytes, throwing if input ends first.
+ */
+template <typename InputIt>
+InputIt skip_bytes(InputIt begin, const InputIt end, const std::uint64_t count) {
+    if constexpr (std::contiguous_iterator<InputIt>) {
+        if (static_cast<std::uint64_t>(end - begin) < count) {
+            throw EndOfInput("String reads past end of buffer");
+        }
+        return begin + count;
+    } else {
+        for (std::uint64_t i = 0; i < count; ++i) {
+            std::tie(begin, std::ignore) = read(begin, end);
+        }
+        return begin;
+    }
+}
+
+/** Skip the body of an item whose header has already been read.  Nested
+ * containers are tracked on the heap rather than by recursion, so arbitrarily
+ * deep input cannot overflow the stack.
+ */
+template <typename InputIt>
+InputIt skip_body(InputIt begin, const InputIt end, Header header) {
+    // A container that is still open around the current item.
+    struct Level {
+        // Entries left, for a definite-length container
+        std::uint64_t remaining;
+        bool indefinite;
+        bool map;
+        // Whether the next item is a map value rather than a key
+        bool value;
+    };
+    std::vector<Level> levels;
+
+    // Account for one completed item, closing every container it finishes.
+    const auto complete = [&levels] {
+        while (!levels.empty()) {
+            auto &level = levels.back();
+            if (level.map && !level.value) {
+                level.value = true;
+                return;
+            }
+            level.value = false;
+            if (level.indefinite || --level.remaining > 0) {
+                return;
+            }
+            levels.pop_back();
+        }
+    };
+
+    while (true) {
+        bool opened = false;
+        switch (header.type) {
+        case MajorType::PositiveInteger:
+        case MajorType::NegativeInteger: {
+            header.get_definite_count();
+            break;
+        }
+        case MajorType::ByteString:
+        case MajorType::Utf8String: {
+            const auto count = header.get_count();
+            if (count) {
+                begin = skip_bytes(begin, end, *count);
+                break;
+            }
+            while (true) {
+                Header chunk;
+                std::tie(begin, chunk) = read_header(begin, end);
+                if (chunk == Header(MajorType::SpecialFloat)) {
+                    break;
+                }
+                if (chunk.type != header.type) {
+                    throw InvalidType("Indefinite string chunk has the wrong major type");
+                }
+                begin = skip_bytes(begin, end, chunk.get_definite_count());
+            }
+            break;
+        }
+        case MajorType::Array:
+        case MajorType::Map: {
+            const auto count = header.get_count();
+            if (!count || *count > 0) {
+                levels.push_back(Level{count.value_or(0), !count, header.type == MajorType::Map, false});
+                opened = true;
+            }
+            break;
+        }
+        case MajorType::SemanticTag: {
+            // The tagged item completes the tag, so it needs no level of its own
+            header.get_definite_count();
+            std::tie(begin, header) = read_header(begin, end);
+            continue;
+        }
+        case MajorType::SpecialFloat: {
+            if (header.count.index() == 0) {
+                const auto tinycount = std::get<0>(header.count);
+                if (tinycount < 20 || (tinycount > 23 && tinycount != 31)) {
+                    throw IllegalSpecialFloat(
+                      "Illegal special float tiny header count " + std::to_string(tinycount));
+                }
+            } else if (header.count.index() == 1) {
+                throw IllegalSpecialFloat(
+                  "Illegal special float single-byte header value " +
+                  std::to_string(std::get<1>(header.count)));
+            }
+            break;
+        }
+        default: {
+            throw std::runtime_error("Illegal major type");
+        }
+        }
+        if (!opened) {
+            complete();
+        }
+
+        // Read the next item, closing indefinite containers at their break.
+        while (true) {
+            if (levels.empty()) {
+                return begin;
+            }
+            std::tie(begin, header) = read_header(begin, end);
+            const auto &level = levels.back();
+            if (!level.indefinite || level.value || header != Header(MajorType::SpecialFloat)) {
+                break;
+            }
+            levels.pop_back();
+            complete();
+        }
+    }
+}
+
+/** Advance past one complete encoded item without decoding it, returning the
+ * iterator just past it.  Indefinite-length items are skipped through their
+ * break.  This accepts exactly what Value::decode accepts.
+ */
+template <typename InputIt>
+InputIt skip(InputIt begin, const InputIt end) {
+    Header header;
+    std::tie(begin, header) = read_header(begin, end);
+    return skip_body(begin, end, header);
+}
+
+/** Compile-time registry of tag handlers, which decode the payload of known
+ * semantic tags into typed nodes instead of a generic SemanticTag.
+ *
+ * A handler is a struct with a static `ids` range listing the tag ids it
+ * claims, and a static `std::optional<Value> decode(std::uint64_t id, Value
+ * &payload)`.  Returning an empty optional, which must leave payload
+ * untouched, falls through to the next handler and finally to SemanticTag.
+ * The first handler claiming an id wins.
+ */
+template <typename... Handlers>
+struct TagRegistry {
+    static inline std::optional<Value> decode(
+      [[maybe_unused]] const std::uint64_t id,
+      [[maybe_unused]] Value &payload) {
+        std::optional<Value> output;
+        static_cast<void>(
+          ((std::ranges::find(Handlers::ids, id) != std::ranges::end(Handlers::ids) &&
+            (output = Handlers::decode(id, payload))) ||
+           ...));
+        return output;
+    }
+};
+
+template <typename... Handlers>
+struct TagRegistry;
+
+/** What decoding does when a map repeats a key.
+ */
+enum class DuplicateKeys {
+    // No checking.  Map keeps the first value, OrderedMap keeps every entry.
+    Unchecked,
+    // Keep the first value for the key.
+    KeepFirst,
+    // Keep the last value for the key, at the position of the first.
+    KeepLast,
+    // Throw DuplicateKey.
+    Reject,
+};
+
+/** The default instrumentation hooks, which do nothing and compile away.
+ * A replacement must provide the same static members.
+ */
+struct NoInstrument {
+    static constexpr bool enabled = false;
+
+    static inline void node(std::size_t) noexcept {
+    }
+
+    static inline void copied(std::size_t) noexcept {
+    }
+
+    static inline void allocated(std::size_t) noexcept {
+    }
+
+    static inline void compared() noexcept {
+    }
+
+    static inline void depth(std::size_t) noexcept {
+    }
+
+    /** Called once the header of each decoded item is read.
+     */
+    static inline void enter(MajorType) noexcept {
+    }
+
+    /** Called once each item is decoded, including the Break closing an
+     * indefinite-length item, with the number of input bytes it spanned, or
+     * 0 when the input iterator is not random access.  Each call matches the
+     * latest unmatched enter().
+     */
+    static inline void leave(const Value &, std::size_t) noexcept {
+    }
+};
+
+/** Compile-time decode options.  To change them, derive from this struct,
+ * redefine the members you want to change, and pass the derived type as the
+ * first template argument of Value::decode.
+ */
+struct DecodePolicy {
+    /** Decode maps into OrderedMap, keeping their entries in wire order,
+     * instead of into Map.
+     */
+    static constexpr bool preserve_map_order = false;
+
+    /** Decode maps into IntMap when at least half their keys are small
+     * integers, instead of into Map.
+     */
+    static constexpr bool small_int_maps = false;
+
+    /** How repeated map keys are handled.  Checking happens as each entry is
+     * inserted, by tree lookup for Map and through OrderedMap's hashed index
+     * for the wire-order and small-integer forms.
+     */
+    static constexpr DuplicateKeys duplicate_keys = DuplicateKeys::Unchecked;
+
+    /** Definite-length maps with at least this many entries are decoded into
+     * a flat buffer, sorted with sort_entries unless already in key order,
+     * and built in one pass, instead of being inserted entry by entry.  Only
+     * affects decoding into Map.
+     */
+    static constexpr std::size_t bulk_map_threshold = 1 << 16;
+
+    /** Sort decoded map entries by key, keeping repeated keys in wire order.
+     * varbor/parallel.hxx has a multithreaded version.
+     */
+    template <typename Entries>
+    static inline void sort_entries(Entries &entries) {
+        std::stable_sort(entries.begin(), entries.end(), [](const auto &a, const auto &b) {
+            return *a.first < *b.first;
+        });
+    }
+
+    /** Handlers for semantic tags that decode into typed nodes.  Set this to
+     * StandardTags, from varbor/tags.hxx, for dates, bignums, decimals, UUIDs
+     * and embedded CBOR.
+     */
+    using tags = TagRegistry<>;
+
+    /** Decode every tag 24 byte string into an EmbeddedCbor that borrows its
+     * bytes from the input rather than copying them.  Only takes effect for
+     * contiguous input.  The input must outlive the decoded Value.
+     */
+    static constexpr bool borrow_embedded_cbor = false;
+
+    /** Decode definite-length strings as views into the input rather than
+     * copies.  Only takes effect for contiguous input.  The input must outlive
+     * the decoded Value.  Decoding a SharedBuffer always borrows, with each
+     * string keeping the buffer alive instead.
+     */
+    static constexpr bool borrow_strings = false;
+
+    /** Reject text strings that are not valid UTF-8.
+     */
+    static constexpr bool validate_utf8 = false;
+
+    /** Accept indefinite-length strings, arrays and maps.
+     */
+    static constexpr bool allow_indefinite = true;
+
+    /** Accept floating point numbers.
+     */
+    static constexpr bool allow_floats = true;
+
+    /** Accept semantic tags.
+     */
+    static constexpr bool allow_tags = true;
+
+    /** The deepest nesting accepted, counting the top-level item as depth 0.
+     */
+    static constexpr std::size_t max_depth = std::numeric_limits<std::size_t>::max();
+
+    /** Hooks called as nodes are decoded.  Set this to Instrumented, from
+     * varbor/instrument.hxx, to count nodes, copies, allocations, map
+     * comparisons and depth.
+     */
+    using instrument = NoInstrument;
+};
+
+template <typename Policy, typename InputIt>
+class Decoder;
+
+namespace detail {
+/** Whether a string is well-formed UTF-8, rejecting overlong forms,
+ * surrogates, and code points past U+10FFFF.
+ */
+inline bool valid_utf8(const std::u8string_view string) noexcept {
+    std::size_t i = 0;
+    while (i < string.size()) {
+        const auto lead = static_cast<std::uint8_t>(string[i]);
+        if (lead < 0x80) {
+            ++i;
+            continue;
+        }
+        std::size_t length;
+        std::uint32_t code_point;
+        std::uint32_t minimum;
+        if ((lead & 0xe0) == 0xc0) {
+            length = 2;
+            code_point = lead & 0x1f;
+            minimum = 0x80;
+        } else if ((lead & 0xf0) == 0xe0) {
+            length = 3;
+            code_point = lead & 0x0f;
+            minimum = 0x800;
+        } else if ((lead & 0xf8) == 0xf0) {
+            length = 4;
+            code_point = lead & 0x07;
+            minimum = 0x10000;
+        } else {
+            return false;
+        }
+        if (string.size() - i < length) {
+            return false;
+        }
+        for (std::size_t j = 1; j < length; ++j) {
+            const auto continuation = static_cast<std::uint8_t>(string[i + j]);
+            if ((continuation & 0xc0) != 0x80) {
+                return false;
+            }
+            code_point = (code_point << 6) | (continuation & 0x3f);
+        }
+        if (code_point < minimum || code_point > 0x10ffff ||
+            (code_point >= 0xd800 && code_point <= 0xdfff)) {
+            return false;
+        }
+        i += length;
+    }
+    return true;
+}
+} // namespace detail
+
+namespace detail {
+/** An input iterator that can expose the bytes it has buffered, like
+ * ByteSource::Iterator, so they can be copied in bulk.
+ */
+template <typename InputIt>
+concept BufferedIterator = requires(const InputIt it, const std::size_t count) {
+    { it.buffered() } -> std::convertible_to<std::span<const std::byte>>;
+    it.consume(count);
+};
+
+/** A map lookup key that reports each comparison made against it, through
+ * the transparent comparator of the decoder's std::map.
+ */
+template <typename Instrument>
+struct CountedKey {
+    const Value &key;
+
+    friend inline bool operator<(const ValuePointer &element, const CountedKey &counted) noexcept {
+        Instrument::compared();
+        return (element <=> counted.key) < 0;
+    }
+
+    friend inline bool operator<(const CountedKey &counted, const ValuePointer &element) noexcept {
+        Instrument::compared();
+        return (element <=> counted.key) > 0;
+    }
+};
+} // namespace detail
+
+/** The decoder behind Value::decode, split up by major type.  Every policy
+ * switch is resolved at compile time, so a stricter policy compiles to a
+ * smaller decoder with fewer branches.
+ */
+template <typename Policy, typename InputIt>
+class Decoder {
+  public:
+    /** Decode one item at the given nesting depth.  Defined out of line and
+     * not inline, so varbor_compiled can instantiate it once.
+     */
+    static std::tuple<InputIt, Value> item(InputIt begin, const InputIt end, std::size_t depth);
+
+  private:
+    /** Read a header and decode the item it starts.
+     */
+    static inline std::tuple<InputIt, Value> dispatch(
+      InputIt begin,
+      const InputIt end,
+      std::size_t depth);
+
+    /** The count from a header, checking indefinite lengths are allowed.
+     */
+    static inline std::optional<std::uint64_t> count(const Header header) {
+        const auto count = header.get_count();
+        if constexpr (!Policy::allow_indefinite) {
+            if (!count) {
+                throw PolicyError("Indefinite-length items are not allowed");
+            }
+        }
+        return count;
+    }
+
+    /** How many of count declared elements, each at least size bytes
+     * long, to reserve room for.  A declared count is only a claim, so it is
+     * capped by what the rest of the input could hold, or by a fixed limit
+     * when the input's length is unknown, and a few bytes cannot make the
+     * decoder allocate gigabytes.
+     */
+    static inline std::size_t reservation(
+      [[maybe_unused]] const InputIt begin,
+      [[maybe_unused]] const InputIt end,
+      const std::uint64_t count,
+      [[maybe_unused]] const std::size_t size) noexcept {
+        if constexpr (std::random_access_iterator<InputIt>) {
+            return static_cast<std::size_t>(
+              std::min<std::uint64_t>(count, static_cast<std::uint64_t>(end - begin) / size));
+        } else {
+            return static_cast<std::size_t>(std::min<std::uint64_t>(count, 4096));
+        }
+    }
+
+    /** Append count raw bytes from the input to a string.
+     */
+    template <typename String>
+    static inline InputIt read_bytes(
+      InputIt begin,
+      const InputIt end,
+      const std::uint64_t count,
+      String &string) {
+        using Char = typename String::value_type;
+        const auto capacity = string.capacity();
+        if constexpr (std::contiguous_iterator<InputIt>) {
+            const auto string_end = skip_bytes(begin, end, count);
+            string.reserve(count);
+            grew(string, capacity);
+            Policy::instrument::copied(count);
+            std::transform(begin, string_end, std::back_inserter(string), [](const auto byte) {
+                return static_cast<Char>(byte);
+            });
+            return string_end;
+        } else if constexpr (detail::BufferedIterator<InputIt>) {
+            // Buffered sources hand out their window, so strings are copied a
+            // chunk at a time rather than a byte at a time.
+            for (std::uint64_t remaining = count; remaining > 0;) {
+                const std::span<const std::byte> chunk = begin.buffered();
+                if (chunk.empty()) {
+                    throw EndOfInput("String reads past end of input");
+                }
+                const auto size = static_cast<std::size_t>(
+                  std::min<std::uint64_t>(remaining, chunk.size()));
+                const auto data = reinterpret_cast<const Char *>(chunk.data());
+                const auto chunk_capacity = string.capacity();
+                string.insert(string.end(), data, data + size);
+                grew(string, chunk_capacity);
+                begin.consume(size);
+                remaining -= size;
+            }
+            Policy::instrument::copied(count);
+            return begin;
+        } else {
+            string.reserve(reservation(begin, end, count, 1));
+            grew(string, capacity);
+            Policy::instrument::copied(count);
+            for (uint64_t i = 0; i < count; ++i) {
+                std::byte byte;
+                std::tie(begin, byte) = read(begin, end);
+                string.push_back(static_cast<Char>(byte));
+            }
+            return begin;
+        }
+    }
+
+    static inline std::tuple<InputIt, Value> byte_string(
+      InputIt begin,
+      const InputIt end,
+      const Header header,
+      const std::size_t depth) {
+        const auto count = Decoder::count(header);
+        if (count) {
+            if constexpr (Policy::borrow_strings && std::contiguous_iterator<InputIt>) {
+                const auto string_end = skip_bytes(begin, end, *count);
+                return {
+                  string_end,
+                  Value(ByteString(std::span<const std::byte>(
+                    std::to_address(begin),
+                    static_cast<std::size_t>(*count))))};
+            } else {
+                std::vector<std::byte> string;
+                begin = read_bytes(begin, end, *count, string);
+                return {begin, Value(ByteString(std::move(string)))};
+            }
+        }
+
+        std::vector<std::byte> string;
+        Value value(Undefined{});
+        std::tie(begin, value) = item(begin, end, depth + 1);
+        for (; value != Break{}; std::tie(begin, value) = item(begin, end, depth + 1)) {
+            const auto chunk = std::get_if<ByteString>(&value.value());
+            if (!chunk) {
+                throw InvalidType("Indefinite byte string chunk has the wrong type");
+            }
+            const std::span<const std::byte> view = *chunk;
+            const auto capacity = string.capacity();
+            string.insert(string.end(), view.begin(), view.end());
+            grew(string, capacity);
+            Policy::instrument::copied(view.size());
+        }
+        return {begin, Value(ByteString(std::move(string)))};
+    }
+
+    static inline std::tuple<InputIt, Value> utf8_string(
+      InputIt begin,
+      const InputIt end,
+      const Header header,
+      const std::size_t depth) {
+        const auto validate = [](const std::u8string_view string) {
+            if constexpr (Policy::validate_utf8) {
+                if (!detail::valid_utf8(string)) {
+                    throw InvalidUtf8("Text string is not valid UTF-8");
+                }
+            }
+        };
+
+        const auto count = Decoder::count(header);
+        if (count) {
+            if constexpr (Policy::borrow_strings && std::contiguous_iterator<InputIt>) {
+                const auto string_end = skip_bytes(begin, end, *count);
+                const std::u8string_view string(
+                  reinterpret_cast<const char8_t *>(std::to_address(begin)),
+                  static_cast<std::size_t>(*count));
+                validate(string);
+                return {string_end, Value(Utf8String(string))};
+            } else {
+                std::u8string string;
+                begin = read_bytes(begin, end, *count, string);
+                validate(string);
+                return {begin, Value(Utf8String(std::move(string)))};
+            }
+        }
+
+        // Each chunk was validated as it was decoded.
+        std::u8string string;
+        Value value(Undefined{});
+        std::tie(begin, value) = item(begin, end, depth + 1);
+        for (; value != Break{}; std::tie(begin, value) = item(begin, end, depth + 1)) {
+            const auto chunk = std::get_if<Utf8String>(&value.value());
+            if (!chunk) {
+                throw InvalidType("Indefinite text string chunk has the wrong type");
+            }
+            const std::u8string_view view = *chunk;
+            const auto capacity = string.capacity();
+            string.append(view);
+            grew(string, capacity);
+            Policy::instrument::copied(view.size());
+        }
+        return {begin, Value(Utf8String(std::move(string)))};
+    }
+
+    static inline std::tuple<InputIt, Value> array(
+      InputIt begin,
+      const InputIt end,
+      const Header header,
+      const std::size_t depth) {
+        std::vector<ValuePointer> array;
+        const auto count = Decoder::count(header);
+        Value value(Undefined{});
+        if (count) {
+            array.reserve(reservation(begin, end, *count, 1));
+            grew(array, 0);
+            for (uint64_t i = 0; i < *count; ++i) {
+                std::tie(begin, value) = item(begin, end, depth + 1);
+                array.push_back(pointer(std::move(value)));
+            }
+        } else {
+            std::tie(begin, value) = item(begin, end, depth + 1);
+            for (; value != Break{}; std::tie(begin, value) = item(begin, end, depth + 1)) {
+                const auto capacity = array.capacity();
+                array.push_back(pointer(std::move(value)));
+                grew(array, capacity);
+            }
+        }
+        return {begin, Value(Array(std::move(array)))};
+    }
+
+    static inline std::tuple<InputIt, Value> map(
+      InputIt begin,
+      const InputIt end,
+      const Header header,
+      const std::size_t depth) {
+        // Both flat forms are built as an OrderedMap, whose lookup index grows
+        // along with it, so duplicate detection stays linear overall.
+        constexpr bool flat = Policy::preserve_map_order || Policy::small_int_maps;
+        std::conditional_t<flat, OrderedMap, std::map<ValuePointer, ValuePointer, std::less<>>>
+          map;
+        const auto insert = [&map](Value key, Value value) {
+            if constexpr (flat) {
+                if constexpr (Policy::duplicate_keys != DuplicateKeys::Unchecked) {
+                    const auto found = map.find(key);
+                    if (found != map.value.end()) {
+                        duplicate(*found->second, std::move(value));
+                        return;
+                    }
+                }
+                const auto capacity = map.value.capacity();
+                map.value.emplace_back(pointer(std::move(key)), pointer(std::move(value)));
+                grew(map.value, capacity);
+            } else {
+                // Keys in order, as deterministic encoders write them, go on
+                // the end after a single comparison with the last key.
+                auto found = map.end();
+                if (!map.empty()) {
+                    Policy::instrument::compared();
+                    const auto order = key <=> *map.rbegin()->first;
+                    if (order == 0) {
+                        duplicate(*map.rbegin()->second, std::move(value));
+                        return;
+                    } else if (order < 0) {
+                        found = lower_bound(map, key);
+                        Policy::instrument::compared();
+                        if (found->first == key) {
+                            duplicate(*found->second, std::move(value));
+                            return;
+                        }
+                    }
+                }
+                Policy::instrument::allocated(2 * sizeof(ValuePointer));
+                map.emplace_hint(found, pointer(std::move(key)), pointer(std::move(value)));
+            }
+        };
+        const auto count = Decoder::count(header);
+        if constexpr (!flat) {
+            if (count && *count >= Policy::bulk_map_threshold) {
+                return bulk_map(begin, end, *count, depth);
+            }
+        }
+        Value key(Undefined{});
+        Value value(Undefined{});
+        if (count) {
+            if constexpr (flat) {
+                map.value.reserve(reservation(begin, end, *count, 2));
+                grew(map.value, 0);
+            }
+            for (uint64_t i = 0; i < *count; ++i) {
+                std::tie(begin, key) = item(begin, end, depth + 1);
+                std::tie(begin, value) = item(begin, end, depth + 1);
+                insert(std::move(key), std::move(value));
+            }
+        } else {
+            std::tie(begin, key) = item(begin, end, depth + 1);
+            for (; key != Break{}; std::tie(begin, key) = item(begin, end, depth + 1)) {
+                std::tie(begin, value) = item(begin, end, depth + 1);
+                insert(std::move(key), std::move(value));
+            }
+        }
+        if constexpr (Policy::preserve_map_order) {
+            if (map.value.size() >= OrderedMap::index_threshold) {
+                map.build_index();
+            }
+            return {begin, Value(std::move(map))};
+        } else if constexpr (Policy::small_int_maps) {
+            return {begin, int_map(std::move(map.value))};
+        } else {
+            return {begin, Value(Map(std::move(map)))};
+        }
+    }
+
+    /** Decode count entries flat, sort them if they are out of order, and
+     * build the Map from the sorted entries in linear time.
+     */
+    static inline std::tuple<InputIt, Value> bulk_map(
+      InputIt begin,
+      const InputIt end,
+      const std::uint64_t count,
+      const std::size_t depth) {
+        std::vector<std::pair<ValuePointer, ValuePointer>> entries;
+        entries.reserve(reservation(begin, end, count, 2));
+        grew(entries, 0);
+        Value key(Undefined{});
+        Value value(Undefined{});
+        for (uint64_t i = 0; i < count; ++i) {
+            std::tie(begin, key) = item(begin, end, depth + 1);
+            std::tie(begin, value) = item(begin, end, depth + 1);
+            const auto capacity = entries.capacity();
+            entries.emplace_back(pointer(std::move(key)), pointer(std::move(value)));
+            grew(entries, capacity);
+        }
+        if (!std::is_sorted(entries.begin(), entries.end(), [](const auto &a, const auto &b) {
+                return *a.first < *b.first;
+            })) {
+            Policy::sort_entries(entries);
+        }
+
+        // Repeated keys are adjacent now, in wire order.
+        std::map<ValuePointer, ValuePointer, std::less<>> map;
+        for (auto &entry : entries) {
+            if (!map.empty()) {
+                Policy::instrument::compared();
+                if (const auto last = std::prev(map.end()); last->first == *entry.first) {
+                    duplicate(*last->second, std::move(*entry.second));
+                    continue;
+                }
+            }
+            Policy::instrument::allocated(2 * sizeof(ValuePointer));
+            map.emplace_hint(map.end(), std::move(entry));
+        }
+        return {begin, Value(Map(std::move(map)))};
+    }
+
+    /** Find where key belongs in a sorted map, counting the comparisons when
+     * instrumented.
+     */
+    template <typename Map>
+    static inline auto lower_bound(Map &map, const Value &key) {
+        if constexpr (Policy::instrument::enabled) {
+            return map.lower_bound(detail::CountedKey<typename Policy::instrument>{key});
+        } else {
+            return map.lower_bound(key);
+        }
+    }
+
+    /** Move a decoded value onto the heap.
+     */
+    static inline ValuePointer pointer(Value &&value) {
+        Policy::instrument::allocated(sizeof(Value));
+        return std::make_unique<Value>(std::move(value));
+    }
+
+    /** Report an allocation if a container's storage grew past old_capacity.
+     */
+    template <typename Container>
+    static inline void grew(
+      [[maybe_unused]] const Container &container,
+      [[maybe_unused]] const std::size_t old_capacity) noexcept {
+        if constexpr (Policy::instrument::enabled) {
+            if (container.capacity() != old_capacity) {
+                Policy::instrument::allocated(
+                  container.capacity() * sizeof(typename Container::value_type));
+            }
+        }
+    }
+
+    /** Resolve a repeated key whose earlier value is existing.
+     */
+    static inline void duplicate(
+      [[maybe_unused]] Value &existing,
+      [[maybe_unused]] Value value) {
+        if constexpr (Policy::duplicate_keys == DuplicateKeys::KeepLast) {
+            existing = std::move(value);
+        } else if constexpr (Policy::duplicate_keys == DuplicateKeys::Reject) {
+            throw DuplicateKey("Map contains a duplicate key");
+        }
+    }
+
+    /** Build an IntMap from decoded entries if enough of their keys are small
+     * integers, and a Map otherwise.
+     */
+    static inline Value int_map(std::vector<std::pair<ValuePointer, ValuePointer>> entries) {
+        const auto small = std::ranges::count_if(entries, [](const auto &entry) {
+            return IntMap::slot(*entry.first).has_value();
+        });
+        if (entries.empty() || static_cast<std::size_t>(small) * 2 < entries.size()) {
+            std::map<ValuePointer, ValuePointer, std::less<>> map;
+            for (auto &entry : entries) {
+                map.insert(std::move(entry));
+            }
+            return Value(Map(std::move(map)));
+        }
+        IntMap map;
+        for (auto &[key, value] : entries) {
+            map.insert(std::move(*key), std::move(*value));
+        }
+        return Value(std::move(map));
+    }
+
+    static inline std::tuple<InputIt, Value> tag(
+      InputIt begin,
+      const InputIt end,
+      const Header header,
+      const std::size_t depth) {
+        if constexpr (!Policy::allow_tags) {
+            throw PolicyError("Semantic tags are not allowed");
+        }
+        const auto count = header.get_definite_count();
+        if constexpr (Policy::borrow_embedded_cbor && std::contiguous_iterator<InputIt>) {
+            if (count == 24) {
+                const auto [string_begin, string_header] = read_header(begin, end);
+                const auto string_count = string_header.get_count();
+                if (string_header.type == MajorType::ByteString && string_count) {
+                    begin = skip_bytes(string_begin, end, *string_count);
+                    return {
+                      begin,
+                      Value(EmbeddedCbor{ByteString(std::span<const std::byte>(
+                        std::to_address(string_begin),
+                        static_cast<std::size_t>(*string_count)))})};
+                }
+            }
+        }
+        Value value(Undefined{});
+        std::tie(begin, value) = item(begin, end, depth + 1);
+        if (auto typed = Policy::tags::decode(count, value)) {
+            return {begin, std::move(*typed)};
+        }
+        return {begin, Value(SemanticTag(count, pointer(std::move(value))))};
+    }
+
+    static inline std::tuple<InputIt, Value> special(const InputIt begin, const Header header) {
+        if constexpr (!Policy::allow_floats) {
+            if (header.count.index() >= 2) {
+                throw PolicyError("Floating point numbers are not allowed");
+            }
+        }
+        switch (header.count.index()) {
+        case 0: {
+            switch (std::get<0>(header.count)) {
+            case 20:
+                return {begin, Value(Boolean(false))};
+            case 21:
+                return {begin, Value(Boolean(true))};
+            case 22:
+                return {begin, Value(Null{})};
+            case 23:
+                return {begin, Value(Undefined{})};
+            case 31:
+                return {begin, Value(Break{})};
+            default:
+                throw IllegalSpecialFloat(
+                  "Illegal special float tiny header count " +
+                  std::to_string(std::get<0>(header.count)));
+            }
+        }
+        case 1:
+            throw IllegalSpecialFloat(
+              "Illegal special float single-byte header value " +
+              std::to_string(std::get<1>(header.count)));
+        case 2:
+            return {begin, Value(Float(read_float16(to_be_bytes(std::get<2>(header.count)))))};
+        case 3:
+            return {
+              begin,
+              Value(Float(from_be_bytes<float>(to_be_bytes(std::get<3>(header.count)))))};
+        case 4:
+            return {
+              begin,
+              Value(Float(from_be_bytes<double>(to_be_bytes(std::get<4>(header.count)))))};
+        default:
+            VARBOR_UNREACHABLE;
+        }
+    }
+};
+
+template <typename Policy, typename InputIt>
+std::tuple<InputIt, Value> Decoder<Policy, InputIt>::item(
+  InputIt begin,
+  const InputIt end,
+  const std::size_t depth) {
+    if (depth > Policy::max_depth) {
+        throw PolicyError("Maximum nesting depth exceeded");
+    }
+    if constexpr (Policy::instrument::enabled) {
+        Policy::instrument::depth(depth);
+        auto result = dispatch(begin, end, depth);
+        Policy::instrument::node(std::get<1>(result).value().index());
+        std::size_t bytes = 0;
+        if constexpr (std::random_access_iterator<InputIt>) {
+            bytes = static_cast<std::size_t>(std::get<0>(result) - begin);
+        }
+        Policy::instrument::leave(std::get<1>(result), bytes);
+        return result;
+    } else {
+        return dispatch(begin, end, depth);
+    }
+}
+
+template <typename Policy, typename InputIt>
+inline std::tuple<InputIt, Value> Decoder<Policy, InputIt>::dispatch(
+  InputIt begin,
+  const InputIt end,
+  const std::size_t depth) {
+    Header header;
+    std::tie(begin, header) = read_header(begin, end);
+    if constexpr (Policy::instrument::enabled) {
+        Policy::instrument::enter(header.type);
+    }
+    switch (header.type) {
+    case MajorType::PositiveInteger: {
+        return {begin, Value(Positive(header.get_definite_count()))};
+    }
+    case MajorType::NegativeInteger: {
+        return {begin, Value(Negative(header.get_definite_count()))};
+    }
+    case MajorType::ByteString: {
+        return byte_string(begin, end, header, depth);
+    }
+    case MajorType::Utf8String: {
+        return utf8_string(begin, end, header, depth);
+    }
+    case MajorType::Array: {
+        return array(begin, end, header, depth);
+    }
+    case MajorType::Map: {
+        return map(begin, end, header, depth);
+    }
+    case MajorType::SemanticTag: {
+        return tag(begin, end, header, depth);
+    }
+    case MajorType::SpecialFloat: {
+        return special(begin, header);
+    }
+    default: {
+        throw std::runtime_error("Illegal major type");
+    }
+    }
+}
+
+template <typename Policy, typename InputIt>
+inline std::tuple<InputIt, Value> Value::decode(InputIt begin, const InputIt end) {
+    return Decoder<Policy, InputIt>::item(begin, end, 0);
+}
+
+namespace detail {
+/** Policy borrowing everything it can, for Value::share to turn into slices.
+ */
+template <typename Policy>
+struct SharingPolicy : Policy {
+    static constexpr bool borrow_embedded_cbor = true;
+    static constexpr bool borrow_strings = true;
+};
+} // namespace detail
+
+template <typename Policy>
+inline Value Value::decode(const SharedBuffer &buffer) {
+    auto value = decode<detail::SharingPolicy<Policy>>(buffer.bytes());
+    value.share(buffer);
+    return value;
+}
+
+
+template <typename Policy>
+inline Value EmbeddedCbor::decode_nested() const {
+    return Value::decode<Policy>(static_cast<std::span<const std::byte>>(bytes));
+}
+} // namespace varbor
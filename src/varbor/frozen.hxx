@@ -0,0 +1,395 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+#pragma once
+
+#include <varbor.hxx>
+
+#include <cstring>
+#include <numeric>
+
+namespace varbor {
+namespace detail {
+/** Whether an encoding holds a float anywhere, found by walking its item
+ * headers, so string contents never count.  Malformed input ends the walk.
+ */
+inline bool holds_float(const std::span<const std::byte> encoded) noexcept {
+    std::size_t position = 0;
+    while (position < encoded.size()) {
+        const auto initial = encoded[position++];
+        const auto type = static_cast<MajorType>(initial >> 5);
+        const auto tinycount = static_cast<std::uint8_t>(initial & std::byte(0b00011111));
+        if (type == MajorType::SpecialFloat && tinycount >= 25 && tinycount <= 27) {
+            return true;
+        }
+        std::uint64_t count = tinycount;
+        if (tinycount >= 24 && tinycount <= 27) {
+            const std::size_t width = std::size_t(1) << (tinycount - 24);
+            if (encoded.size() - position < width) {
+                return false;
+            }
+            count = 0;
+            for (std::size_t i = 0; i < width; ++i) {
+                count = (count << 8) | static_cast<std::uint64_t>(encoded[position++]);
+            }
+        }
+        if ((type == MajorType::ByteString || type == MajorType::Utf8String) && tinycount != 31) {
+            if (encoded.size() - position < count) {
+                return false;
+            }
+            position += static_cast<std::size_t>(count);
+        }
+    }
+    return false;
+}
+
+/** Output iterator that writes into a fixed buffer and counts everything
+ * written to it, so an encoding too long for the buffer is noticed instead of
+ * overrunning it.
+ */
+class BufferIterator {
+  private:
+    std::span<std::byte> buffer_;
+    std::size_t count_ = 0;
+
+  public:
+    struct Sink {
+        BufferIterator *iterator;
+
+        inline const Sink &operator=(const std::byte byte) const noexcept {
+            auto &it = *iterator;
+            if (it.count_ < it.buffer_.size()) {
+                it.buffer_[it.count_] = byte;
+            }
+            return *this;
+        }
+    };
+
+    using difference_type = std::ptrdiff_t;
+    using value_type = void;
+
+    inline explicit BufferIterator(const std::span<std::byte> buffer) noexcept : buffer_(buffer) {
+    }
+
+    inline Sink operator*() noexcept {
+        return {this};
+    }
+
+    inline BufferIterator &operator++() noexcept {
+        ++count_;
+        return *this;
+    }
+
+    inline BufferIterator operator++(int) noexcept {
+        auto old = *this;
+        ++count_;
+        return old;
+    }
+
+    /** How many bytes were written, including any that did not fit.
+     */
+    inline std::size_t count() const noexcept {
+        return count_;
+    }
+};
+} // namespace detail
+
+/** An immutable Map laid out for lookups.  Keys are stored encoded, back to
+ * back in one buffer, and indexed by a minimal perfect hash of their
+ * Value::hash.  Looking up a key that encodes to at most small_key bytes and
+ * holds no float encodes it once, onto the stack, and then takes one hash of
+ * those bytes, one probe and one memcmp.  Longer keys are hashed, then
+ * encoded a second time against their entry's key.  Keys holding a float may
+ * encode differently from an equal key, like 0.0 and -0.0, so if that
+ * comparison fails their entry's key is also decoded and compared.  Either
+ * way, a lookup finds the same keys as the Map would.  Entries keep the order
+ * of the Map they were frozen from, and encode exactly like it.
+ *
+ * Freezing is shallow: maps nested in the values stay Maps.
+ */
+class FrozenMap {
+  private:
+    // Encoded keys, back to back; key i is [offsets_[i], offsets_[i + 1]).
+    std::vector<std::byte> keys_;
+    std::vector<std::size_t> offsets_;
+    std::vector<Value> values_;
+    // Value::hash of every key.
+    std::vector<std::uint64_t> hashes_;
+
+    // Hash and displace: a key's hash picks its bucket, and the bucket's pair
+    // of displacements moves the key's two hash-derived positions to its
+    // slot, which holds the key's entry index.
+    std::vector<std::array<std::uint32_t, 2>> displacements_;
+    std::vector<std::uint32_t> slots_;
+    std::uint64_t seed_ = 0;
+
+    // Seeds to try before giving up on finding a perfect hash.
+    static constexpr std::uint64_t max_seeds = 64;
+
+    inline std::uint64_t seeded(std::uint64_t hash) const noexcept {
+        hash += (seed_ + 1) * 0x9e3779b97f4a7c15ull;
+        hash = (hash ^ (hash >> 33)) * 0xff51afd7ed558ccdull;
+        return hash ^ (hash >> 33);
+    }
+
+    inline std::size_t bucket(std::uint64_t hash) const noexcept {
+        hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+        hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebull;
+        return static_cast<std::size_t>((hash ^ (hash >> 31)) % displacements_.size());
+    }
+
+    inline std::size_t slot(
+      const std::uint64_t hash,
+      const std::array<std::uint32_t, 2> displacement) const noexcept {
+        const std::uint64_t size = slots_.size();
+        const auto first = (hash & 0xffffffffu) % size;
+        const auto second = (hash >> 32) % size;
+        return static_cast<std::size_t>(
+          (first + displacement[0] * second + displacement[1]) % size);
+    }
+
+    /** Find displacements for every bucket, fullest first, that send all its
+     * keys to free slots.  Buckets of one key, which come last, go straight
+     * to the next free slot.  Returns false if some bucket cannot be placed,
+     * so the caller can retry with another seed.
+     */
+    inline bool index() {
+        const auto size = values_.size();
+        constexpr auto empty = std::numeric_limits<std::uint32_t>::max();
+        slots_.assign(size, empty);
+        displacements_.assign(std::max<std::size_t>(size / 4, 1), {0, 0});
+
+        std::vector<std::uint64_t> hashes(size);
+        std::vector<std::vector<std::uint32_t>> buckets(displacements_.size());
+        for (std::size_t i = 0; i < size; ++i) {
+            hashes[i] = seeded(hashes_[i]);
+            buckets[bucket(hashes[i])].push_back(static_cast<std::uint32_t>(i));
+        }
+        std::vector<std::size_t> order(buckets.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&buckets](const auto a, const auto b) {
+            return buckets[a].size() > buckets[b].size();
+        });
+
+        std::size_t next_free = 0;
+        std::vector<std::size_t> taken;
+        for (const auto b : order) {
+            const auto &entries = buckets[b];
+            if (entries.empty()) {
+                break;
+            }
+            if (entries.size() == 1) {
+                while (slots_[next_free] != empty) {
+                    ++next_free;
+                }
+                const auto first = (hashes[entries[0]] & 0xffffffffu) % size;
+                displacements_[b] = {
+                  0,
+                  static_cast<std::uint32_t>((next_free + size - first) % size)};
+                slots_[next_free] = entries[0];
+                continue;
+            }
+
+            bool placed = false;
+            for (std::size_t attempt = 0; !placed && attempt < size * 64; ++attempt) {
+                const std::array<std::uint32_t, 2> displacement{
+                  static_cast<std::uint32_t>(attempt / size),
+                  static_cast<std::uint32_t>(attempt % size)};
+                taken.clear();
+                placed = true;
+                for (const auto entry : entries) {
+                    const auto s = slot(hashes[entry], displacement);
+                    if (slots_[s] != empty || std::ranges::find(taken, s) != taken.end()) {
+                        placed = false;
+                        break;
+                    }
+                    taken.push_back(s);
+                }
+                if (placed) {
+                    displacements_[b] = displacement;
+                    for (std::size_t i = 0; i < entries.size(); ++i) {
+                        slots_[taken[i]] = entries[i];
+                    }
+                }
+            }
+            if (!placed) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /** The entry index probed for a key with Value::hash hash.
+     */
+    inline std::size_t entry(std::uint64_t hash) const noexcept {
+        hash = seeded(hash);
+        return slots_[slot(hash, displacements_[bucket(hash)])];
+    }
+
+    /** The value for an encoded key holding no float, which Value::hash
+     * hashes exactly as encoded, or nullptr.
+     */
+    inline const Value *match(const std::span<const std::byte> key) const noexcept {
+        const auto hash = std::copy(key.begin(), key.end(), HashingIterator{}).hash();
+        const auto i = entry(hash);
+        const auto candidate = this->key(i);
+        if (hashes_[i] != hash || candidate.size() != key.size() ||
+            std::memcmp(candidate.data(), key.data(), key.size()) != 0) {
+            return nullptr;
+        }
+        return &values_[i];
+    }
+
+  public:
+    /** Keys encoding to at most this many bytes are looked up from a single
+     * encoding on the stack.
+     */
+    static constexpr std::size_t small_key = 64;
+
+    /** One entry, with its key still encoded.
+     */
+    struct Entry {
+        std::span<const std::byte> key;
+        const Value &value;
+    };
+
+    FrozenMap() noexcept = default;
+
+    /** Freeze map, moving its values.
+     */
+    inline explicit FrozenMap(Map map) {
+        if (map.value.size() >= std::numeric_limits<std::uint32_t>::max()) {
+            throw std::length_error("Map is too large to freeze");
+        }
+        offsets_.reserve(map.value.size() + 1);
+        values_.reserve(map.value.size());
+        hashes_.reserve(map.value.size());
+        offsets_.push_back(0);
+        for (auto &[key, value] : map.value) {
+            key->encode(std::back_inserter(keys_));
+            offsets_.push_back(keys_.size());
+            values_.push_back(std::move(*value));
+            hashes_.push_back(key->hash());
+        }
+        // Only keys whose Value::hash collides, which no seed separates, should
+        // run out of seeds.
+        while (!index()) {
+            if (++seed_ == max_seeds) {
+                throw std::runtime_error("No perfect hash found for the Map's keys");
+            }
+        }
+    }
+
+    inline std::size_t size() const noexcept {
+        return values_.size();
+    }
+
+    inline bool empty() const noexcept {
+        return values_.empty();
+    }
+
+    /** The encoded key of entry i.
+     */
+    inline std::span<const std::byte> key(const std::size_t i) const noexcept {
+        return std::span<const std::byte>(keys_).subspan(
+          offsets_[i],
+          offsets_[i + 1] - offsets_[i]);
+    }
+
+    inline const Value &value(const std::size_t i) const noexcept {
+        return values_[i];
+    }
+
+    inline Entry operator[](const std::size_t i) const noexcept {
+        return Entry{key(i), values_[i]};
+    }
+
+    /** The value for an already encoded key, or nullptr.  An encoding that
+     * holds a float, which Value::hash does not hash as encoded, is decoded
+     * and looked up with find, and throws as Value::decode would if it is
+     * malformed.
+     */
+    inline const Value *find_encoded(const std::span<const std::byte> key) const {
+        if (values_.empty()) {
+            return nullptr;
+        }
+        if (detail::holds_float(key)) {
+            return find(Value::decode(key));
+        }
+        return match(key);
+    }
+
+    /** The value for key, or nullptr.  A small key without a float is
+     * encoded once onto the stack and matched like an encoded one.  Any other
+     * key is hashed and then compared by encoding it against its entry's key
+     * without materializing it.  Only a key holding a float can encode
+     * differently from its entry's and still be equal, so only then is the
+     * entry's key decoded to compare.
+     */
+    inline const Value *find(const Value &key) const {
+        if (values_.empty()) {
+            return nullptr;
+        }
+        std::array<std::byte, small_key> buffer;
+        const auto size = key.encode(detail::BufferIterator(buffer)).count();
+        if (size <= buffer.size()) {
+            const std::span<const std::byte> encoded(buffer.data(), size);
+            if (!detail::holds_float(encoded)) {
+                return match(encoded);
+            }
+        }
+
+        const auto hash = key.hash();
+        const auto i = entry(hash);
+        if (hashes_[i] != hash) {
+            return nullptr;
+        }
+        const auto candidate = this->key(i);
+        if (std::is_eq(key.encode(ComparingIterator(candidate)).order())) {
+            return &values_[i];
+        }
+        if (!detail::holds_float(candidate)) {
+            return nullptr;
+        }
+        return Value::decode(candidate) == key ? &values_[i] : nullptr;
+    }
+
+    /** Encode exactly as the Map this was frozen from.
+     */
+    template <typename OutputIt>
+    OutputIt encode(OutputIt output) const {
+        output = write_header(output, MajorType::Map, size());
+        for (std::size_t i = 0; i < size(); ++i) {
+            output = std::copy(key(i).begin(), key(i).end(), output);
+            output = values_[i].encode(output);
+        }
+        return output;
+    }
+
+    inline std::vector<std::byte> encode() const {
+        std::vector<std::byte> output;
+        encode(std::back_inserter(output));
+        return output;
+    }
+
+    /** Turn back into a Map, decoding the keys and moving the values.
+     */
+    inline Map thaw() && {
+        Map map;
+        for (std::size_t i = 0; i < size(); ++i) {
+            map.value.emplace_hint(
+              map.value.end(),
+              std::make_unique<Value>(Value::decode(key(i))),
+              std::make_unique<Value>(std::move(values_[i])));
+        }
+        *this = FrozenMap();
+        return map;
+    }
+};
+
+/** Freeze map for read-only lookups.
+ */
+inline FrozenMap freeze(Map map) {
+    return FrozenMap(std::move(map));
+}
+} // namespace varbor
@@ -0,0 +1,150 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+#pragma once
+
+#include <varbor.hxx>
+
+#include <utility>
+
+namespace varbor {
+/** Counters gathered by Instrumented over one or more decode or encode calls.
+ * Allocation sizes are the sizes the library asked for, without allocator
+ * overhead; a std::map node is counted as its key and value pointers.
+ */
+struct Statistics {
+    // Nodes decoded or encoded, indexed like Variant.
+    std::array<std::uint64_t, std::variant_size_v<Variant>> nodes{};
+
+    // Bytes copied out of the input into owned strings.
+    std::uint64_t bytes_copied = 0;
+
+    // Bytes written by an encode.
+    std::uint64_t bytes_written = 0;
+
+    std::uint64_t allocations = 0;
+    std::uint64_t allocated_bytes = 0;
+    std::uint64_t largest_allocation = 0;
+
+    // Key comparisons made while inserting into sorted maps.
+    std::uint64_t map_comparisons = 0;
+
+    // The deepest nesting reached, counting the top-level item as depth 0.
+    std::size_t max_depth = 0;
+
+    template <detail::Alternative T>
+    inline std::uint64_t count() const noexcept {
+        return nodes[detail::variant_index<T, Variant>::value];
+    }
+
+    inline std::uint64_t total_nodes() const noexcept {
+        std::uint64_t total = 0;
+        for (const auto count : nodes) {
+            total += count;
+        }
+        return total;
+    }
+
+    bool operator==(const Statistics &other) const noexcept = default;
+};
+
+/** Instrumentation hooks that count into a thread-local Statistics.  Decode
+ * with a policy whose instrument is Instrumented, or encode through an
+ * Instrumented::Output, then call take() for that call's counters.
+ */
+struct Instrumented {
+    static constexpr bool enabled = true;
+
+    static inline Statistics &statistics() noexcept {
+        thread_local Statistics statistics;
+        return statistics;
+    }
+
+    /** Return the counters gathered so far and reset them.
+     */
+    static inline Statistics take() noexcept {
+        return std::exchange(statistics(), Statistics{});
+    }
+
+    static inline void node(const std::size_t index) noexcept {
+        ++statistics().nodes[index];
+    }
+
+    static inline void copied(const std::size_t size) noexcept {
+        statistics().bytes_copied += size;
+    }
+
+    static inline void allocated(const std::size_t size) noexcept {
+        auto &statistics = Instrumented::statistics();
+        ++statistics.allocations;
+        statistics.allocated_bytes += size;
+        statistics.largest_allocation = std::max<std::uint64_t>(
+          statistics.largest_allocation,
+          size);
+    }
+
+    static inline void compared() noexcept {
+        ++statistics().map_comparisons;
+    }
+
+    static inline void depth(const std::size_t depth) noexcept {
+        auto &statistics = Instrumented::statistics();
+        statistics.max_depth = std::max(statistics.max_depth, depth);
+    }
+
+    static inline void enter(MajorType) noexcept {
+    }
+
+    static inline void leave(const Value &, std::size_t) noexcept {
+    }
+
+    /** Output iterator adaptor that counts the nodes, depth and bytes of an
+     * encode into statistics(), and passes the bytes on to output.
+     */
+    template <typename OutputIt>
+    class Output {
+      private:
+        OutputIt output_;
+        std::size_t depth_ = 0;
+
+      public:
+        using difference_type = std::ptrdiff_t;
+        using value_type = void;
+
+        inline Output(OutputIt output) : output_(std::move(output)) {
+        }
+
+        inline decltype(auto) operator*() {
+            return *output_;
+        }
+
+        inline Output &operator++() {
+            ++output_;
+            ++statistics().bytes_written;
+            return *this;
+        }
+
+        inline Output operator++(int) {
+            auto old = *this;
+            ++*this;
+            return old;
+        }
+
+        /** Called by Value::encode around each node.
+         */
+        inline void enter(const std::size_t index) noexcept {
+            node(index);
+            depth(depth_);
+            ++depth_;
+        }
+
+        inline void leave() noexcept {
+            --depth_;
+        }
+
+        inline const OutputIt &base() const noexcept {
+            return output_;
+        }
+    };
+};
+} // namespace varbor
@@ -0,0 +1,10 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+#define VARBOR_COMPILED_SOURCE
+
+#include <varbor/io.hxx>
+
+namespace varbor {
+template Value decode<DecodePolicy>(ByteSource &source);
+} // namespace varbor
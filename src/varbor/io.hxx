@@ -0,0 +1,314 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+#pragma once
+
+#include <varbor.hxx>
+
+#include <istream>
+#include <ostream>
+
+// Header-only by default.  varbor::varbor_compiled defines VARBOR_COMPILED for
+// its users, and the functions below are then compiled once into that library
+// rather than in every translation unit.
+#ifdef VARBOR_COMPILED
+#define VARBOR_COMPILED_INLINE
+#else
+#define VARBOR_COMPILED_INLINE inline
+#endif
+
+namespace varbor {
+/** Type-erased, buffered input.  Subclasses only implement refill(); reading
+ * within the buffered window is inline, so one decoder instantiation serves
+ * every kind of source.
+ */
+class ByteSource {
+  protected:
+    const std::byte *position_ = nullptr;
+    const std::byte *end_ = nullptr;
+
+    /** Make more bytes available in [position_, end_).  Returns false at the
+     * end of input.
+     */
+    virtual bool refill() = 0;
+
+  public:
+    class Iterator;
+
+    ByteSource() noexcept = default;
+    ByteSource(const ByteSource &) = delete;
+    ByteSource &operator=(const ByteSource &) = delete;
+    virtual ~ByteSource() = default;
+
+    /** The bytes buffered right now, refilling first if there are none.
+     * Empty only at the end of input.
+     */
+    inline std::span<const std::byte> buffered() {
+        if (position_ == end_ && !refill()) {
+            return {};
+        }
+        return {position_, end_};
+    }
+
+    /** Move past count buffered bytes.
+     */
+    inline void consume(const std::size_t count) noexcept {
+        position_ += count;
+    }
+
+    inline Iterator begin() noexcept;
+    inline Iterator end() noexcept;
+};
+
+/** Input iterator over a ByteSource.  Advancing it consumes from the source,
+ * so after a decode the source is positioned just past the item.  Only
+ * comparisons against end() are meaningful.
+ */
+class ByteSource::Iterator {
+  private:
+    ByteSource *source_ = nullptr;
+
+    static inline bool at_end(ByteSource *const source) {
+        return source == nullptr || (source->position_ == source->end_ && !source->refill());
+    }
+
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = std::byte;
+
+    Iterator() noexcept = default;
+
+    inline explicit Iterator(ByteSource *const source) noexcept : source_(source) {
+    }
+
+    inline std::byte operator*() const noexcept {
+        return *source_->position_;
+    }
+
+    inline Iterator &operator++() noexcept {
+        ++source_->position_;
+        return *this;
+    }
+
+    inline void operator++(int) noexcept {
+        ++source_->position_;
+    }
+
+    inline bool operator==(const Iterator &other) const {
+        return at_end(source_) == at_end(other.source_);
+    }
+
+    inline std::span<const std::byte> buffered() const {
+        return source_->buffered();
+    }
+
+    inline void consume(const std::size_t count) const noexcept {
+        source_->consume(count);
+    }
+};
+
+inline ByteSource::Iterator ByteSource::begin() noexcept {
+    return Iterator(this);
+}
+
+inline ByteSource::Iterator ByteSource::end() noexcept {
+    return Iterator();
+}
+
+/** A source over bytes already in memory.
+ */
+class SpanSource : public ByteSource {
+  protected:
+    inline bool refill() override {
+        return false;
+    }
+
+  public:
+    inline explicit SpanSource(const std::span<const std::byte> bytes) noexcept {
+        position_ = bytes.data();
+        end_ = bytes.data() + bytes.size();
+    }
+};
+
+/** A source reading from a stream through a buffer.  The stream is read ahead
+ * by up to a buffer's worth, so bytes after the last decoded item may already
+ * have been taken from it.
+ */
+class StreamSource : public ByteSource {
+  private:
+    std::istream &stream_;
+    std::vector<std::byte> buffer_;
+
+  protected:
+    inline bool refill() override {
+        const auto count = stream_.rdbuf()->sgetn(
+          reinterpret_cast<char *>(buffer_.data()),
+          static_cast<std::streamsize>(buffer_.size()));
+        if (count <= 0) {
+            return false;
+        }
+        position_ = buffer_.data();
+        end_ = buffer_.data() + count;
+        return true;
+    }
+
+  public:
+    inline explicit StreamSource(std::istream &stream, const std::size_t buffer_size = 4096) :
+        stream_(stream),
+        buffer_(std::max<std::size_t>(buffer_size, 1)) {
+    }
+};
+
+/** Type-erased, buffered output.  Subclasses only implement drain(); writing
+ * into the buffer is inline, so one encoder instantiation serves every kind of
+ * sink.  Call flush() when done, or the last buffered bytes stay buffered.
+ */
+class ByteSink {
+  private:
+    std::byte *begin_ = nullptr;
+    std::byte *position_ = nullptr;
+    std::byte *end_ = nullptr;
+
+  protected:
+    /** Take bytes that were written to the buffer.
+     */
+    virtual void drain(std::span<const std::byte> bytes) = 0;
+
+    /** Set the buffer written into before each drain.
+     */
+    inline void buffer(const std::span<std::byte> buffer) noexcept {
+        begin_ = buffer.data();
+        position_ = buffer.data();
+        end_ = buffer.data() + buffer.size();
+    }
+
+  public:
+    class Iterator;
+
+    ByteSink() noexcept = default;
+    ByteSink(const ByteSink &) = delete;
+    ByteSink &operator=(const ByteSink &) = delete;
+    virtual ~ByteSink() = default;
+
+    inline void put(const std::byte byte) {
+        if (position_ == end_) {
+            flush();
+        }
+        *position_ = byte;
+        ++position_;
+    }
+
+    /** Drain everything written so far.
+     */
+    inline void flush() {
+        if (position_ != begin_) {
+            drain({begin_, position_});
+            position_ = begin_;
+        }
+    }
+
+    inline Iterator begin() noexcept;
+};
+
+/** Output iterator into a ByteSink.
+ */
+class ByteSink::Iterator {
+  private:
+    ByteSink *sink_ = nullptr;
+
+  public:
+    struct Proxy {
+        ByteSink *sink;
+
+        inline const Proxy &operator=(const std::byte byte) const {
+            sink->put(byte);
+            return *this;
+        }
+    };
+
+    using difference_type = std::ptrdiff_t;
+    using value_type = void;
+
+    Iterator() noexcept = default;
+
+    inline explicit Iterator(ByteSink *const sink) noexcept : sink_(sink) {
+    }
+
+    inline Proxy operator*() const noexcept {
+        return {sink_};
+    }
+
+    inline Iterator &operator++() noexcept {
+        return *this;
+    }
+
+    inline Iterator operator++(int) noexcept {
+        return *this;
+    }
+};
+
+inline ByteSink::Iterator ByteSink::begin() noexcept {
+    return Iterator(this);
+}
+
+/** A sink appending to a vector.
+ */
+class VectorSink : public ByteSink {
+  private:
+    std::vector<std::byte> &output_;
+    std::array<std::byte, 4096> buffer_;
+
+  protected:
+    inline void drain(const std::span<const std::byte> bytes) override {
+        output_.insert(output_.end(), bytes.begin(), bytes.end());
+    }
+
+  public:
+    inline explicit VectorSink(std::vector<std::byte> &output) noexcept : output_(output) {
+        buffer(buffer_);
+    }
+};
+
+/** A sink writing to a stream through a buffer.
+ */
+class StreamSink : public ByteSink {
+  private:
+    std::ostream &stream_;
+    std::vector<std::byte> buffer_;
+
+  protected:
+    inline void drain(const std::span<const std::byte> bytes) override {
+        stream_.write(
+          reinterpret_cast<const char *>(bytes.data()),
+          static_cast<std::streamsize>(bytes.size()));
+    }
+
+  public:
+    inline explicit StreamSink(std::ostream &stream, const std::size_t buffer_size = 4096) :
+        stream_(stream),
+        buffer_(std::max<std::size_t>(buffer_size, 1)) {
+        buffer(buffer_);
+    }
+};
+
+/** Decode one item from source, leaving it positioned after the item.
+ */
+template <typename Policy = DecodePolicy>
+Value decode(ByteSource &source) {
+    return std::get<1>(Value::decode<Policy>(source.begin(), source.end()));
+}
+
+/** Encode value into sink and flush it.
+ */
+VARBOR_COMPILED_INLINE void encode(const Value &value, ByteSink &sink);
+
+#if defined(VARBOR_COMPILED) && !defined(VARBOR_COMPILED_SOURCE)
+extern template Value decode<DecodePolicy>(ByteSource &source);
+#else
+VARBOR_COMPILED_INLINE void encode(const Value &value, ByteSink &sink) {
+    value.encode(sink.begin());
+    sink.flush();
+}
+#endif
+} // namespace varbor
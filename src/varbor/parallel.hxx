@@ -0,0 +1,168 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+#pragma once
+
+#include <varbor.hxx>
+#include <varbor/walk.hxx>
+
+#include <atomic>
+#include <future>
+#include <optional>
+#include <thread>
+
+namespace varbor {
+/** Stable merge sort over up to threads threads.  Each half is sorted on
+ * its own thread, recursively, down to runs of min_run elements, which are
+ * sorted with std::stable_sort, and the halves are merged on the way back up.
+ * Needs Threads::Threads, or -pthread, when linking.
+ */
+template <std::random_access_iterator RandomIt, typename Compare>
+inline void parallel_stable_sort(
+  const RandomIt begin,
+  const RandomIt end,
+  Compare compare,
+  const std::size_t threads = std::max(std::thread::hardware_concurrency(), 1u),
+  const std::size_t min_run = 1 << 14) {
+    const auto size = static_cast<std::size_t>(end - begin);
+    if (threads < 2 || size < 2 * min_run) {
+        std::stable_sort(begin, end, compare);
+        return;
+    }
+    const auto middle = begin + static_cast<std::ptrdiff_t>(size / 2);
+    // Exceptions from the other half, such as bad_alloc, come back through
+    // the future.
+    auto left = std::async(std::launch::async, [=] {
+        parallel_stable_sort(begin, middle, compare, threads / 2, min_run);
+    });
+    parallel_stable_sort(middle, end, compare, threads - threads / 2, min_run);
+    left.get();
+    std::inplace_merge(begin, middle, end, compare);
+}
+
+/** Decode policy that sorts out of order maps of at least bulk_map_threshold
+ * entries on every core before building them.  Derive from this instead of
+ * DecodePolicy to combine it with other options.
+ */
+struct ParallelDecodePolicy : DecodePolicy {
+    template <typename Entries>
+    static inline void sort_entries(Entries &entries) {
+        parallel_stable_sort(entries.begin(), entries.end(), [](const auto &a, const auto &b) {
+            return *a.first < *b.first;
+        });
+    }
+};
+
+/** Call visit(node, path, result) for every node under root, in pre-order
+ * within each subtree, on up to threads threads, and combine their results
+ * with reduce(Result &into, Result &&from).  Every thread's result starts as
+ * Result{}, which must be an identity for reduce, such as zero for a sum.
+ * init is reduced in once, as with std::reduce.
+ *
+ * Nodes near the root are visited on the calling thread, a level at a time,
+ * until there are at least tasks_per_thread tasks per thread, or for at most
+ * 64 levels, and the threads then take the remaining tasks in turn.  A task
+ * is one subtree, or, for a container with more children than that, a run
+ * of its children, so a wide array or map is split into about as many runs
+ * as there are tasks wanted, each walked by one cursor.  Which nodes end up
+ * in which result depends on timing, so reduce must be associative and
+ * commutative.
+ *
+ * As with BasicCursor, when V is Value, visit may modify or replace the node
+ * it is given, but nothing above it.
+ */
+template <typename V, std::default_initializable Result, typename Visit, typename Reduce>
+inline Result parallel_reduce(
+  V &root,
+  Result init,
+  Visit visit,
+  Reduce reduce,
+  const std::size_t threads = std::max(std::thread::hardware_concurrency(), 1u),
+  const std::size_t tasks_per_thread = 8) {
+    // Nodes found so far, each linked to its parent, so a path costs one
+    // step per node here rather than a copy of the whole path.
+    struct Node {
+        V *value;
+        std::size_t parent;
+        Step step;
+    };
+    constexpr auto none = std::numeric_limits<std::size_t>::max();
+    std::vector<Node> nodes{Node{&root, none, Step{}}};
+    const auto path = [&nodes](std::size_t node) {
+        std::vector<Step> path;
+        for (; nodes[node].parent != none; node = nodes[node].parent) {
+            path.push_back(nodes[node].step);
+        }
+        std::ranges::reverse(path);
+        return path;
+    };
+
+    // The subtree at node, or a run of the children of the container at node.
+    struct Task {
+        std::size_t node;
+        std::optional<typename BasicCursor<V>::Range> children;
+    };
+    std::vector<Task> tasks;
+
+    // Split breadth first; nodes [level, nodes.size()) are unvisited, and
+    // each is a task unless split further.
+    constexpr std::size_t max_split_depth = 64;
+    Result result{};
+    std::size_t level = 0;
+    const auto wanted = threads < 2 ? 1 : threads * tasks_per_thread;
+    for (std::size_t depth = 0; depth < max_split_depth && level < nodes.size() &&
+         tasks.size() + nodes.size() - level < wanted;
+         ++depth) {
+        const auto level_end = nodes.size();
+        for (; level < level_end; ++level) {
+            visit(*nodes[level].value, std::span<const Step>(path(level)), result);
+            const auto count = BasicCursor<V>::children(*nodes[level].value);
+            if (count > wanted) {
+                for (auto &range :
+                     BasicCursor<V>::split(*nodes[level].value, (count + wanted - 1) / wanted)) {
+                    tasks.push_back(Task{level, std::move(range)});
+                }
+                continue;
+            }
+            BasicCursor<V> children(*nodes[level].value);
+            while (children.next() && children.depth() == 1) {
+                nodes.push_back(Node{&children.value(), level, children.path().back()});
+                children.skip();
+                children.next();
+            }
+        }
+    }
+    for (; level < nodes.size(); ++level) {
+        tasks.push_back(Task{level, std::nullopt});
+    }
+
+    std::atomic<std::size_t> next = 0;
+    const auto work = [&] {
+        Result partial{};
+        for (auto task = next++; task < tasks.size(); task = next++) {
+            const auto &[node, children] = tasks[task];
+            auto cursor = children ? BasicCursor<V>(*children, path(node))
+                                   : BasicCursor<V>(*nodes[node].value, path(node));
+            do {
+                if (cursor.event() == BasicCursor<V>::Event::Enter) {
+                    visit(cursor.value(), cursor.path(), partial);
+                }
+            } while (cursor.next());
+        }
+        return partial;
+    };
+    const auto workers = std::min(std::max<std::size_t>(threads, 1), tasks.size());
+    std::vector<std::future<Result>> others;
+    for (std::size_t i = 1; i < workers; ++i) {
+        others.push_back(std::async(std::launch::async, work));
+    }
+    if (workers > 0) {
+        reduce(result, work());
+    }
+    for (auto &other : others) {
+        reduce(result, other.get());
+    }
+    reduce(init, std::move(result));
+    return init;
+}
+} // namespace varbor
@@ -0,0 +1,272 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+#pragma once
+
+#include <varbor.hxx>
+
+#include <initializer_list>
+
+namespace varbor {
+/** One step of a path into encoded data.  Against an array, a non-negative
+ * integer step is an index.  Against a map, every step is a key, matched by
+ * comparing its encoding with the encoded keys byte for byte.
+ */
+class PathStep {
+  private:
+    std::vector<std::byte> key_;
+    std::optional<std::uint64_t> index_;
+
+  public:
+    template <typename T>
+        requires std::constructible_from<Value, T>
+    inline PathStep(T &&key) {
+        using Key = std::remove_cvref_t<T>;
+        if constexpr (std::integral<Key> && !std::same_as<Key, bool>) {
+            if (key >= 0) {
+                index_ = static_cast<std::uint64_t>(key);
+            }
+        }
+        key_ = Value(std::forward<T>(key)).encode();
+    }
+
+    inline std::span<const std::byte> key() const noexcept {
+        return key_;
+    }
+
+    inline const std::optional<std::uint64_t> &index() const noexcept {
+        return index_;
+    }
+};
+
+/** The position and size in bytes of one encoded item within a buffer.
+ */
+struct Extent {
+    std::size_t offset = 0;
+    std::size_t size = 0;
+
+    bool operator==(const Extent &other) const noexcept = default;
+};
+
+namespace detail {
+/** Whether the next item in an indefinite-length container is its break.
+ */
+inline bool at_break(
+  const std::span<const std::byte>::iterator begin,
+  const std::span<const std::byte>::iterator end) {
+    if (begin == end) {
+        throw EndOfInput("Reached end of input early");
+    }
+    return *begin == std::byte(0xff);
+}
+
+/** Write an integer header padded out to exactly size bytes, if it fits.
+ */
+template <typename OutputIt>
+bool patch_integer(
+  OutputIt output,
+  const std::size_t size,
+  const MajorType type,
+  const std::uint64_t count) {
+    switch (size) {
+    case 2:
+        if (count > std::numeric_limits<std::uint8_t>::max()) {
+            return false;
+        }
+        write_header(
+          output,
+          Header{type, Count(std::in_place_index<1>, static_cast<std::uint8_t>(count))});
+        return true;
+    case 3:
+        if (count > std::numeric_limits<std::uint16_t>::max()) {
+            return false;
+        }
+        write_header(
+          output,
+          Header{type, Count(std::in_place_index<2>, static_cast<std::uint16_t>(count))});
+        return true;
+    case 5:
+        if (count > std::numeric_limits<std::uint32_t>::max()) {
+            return false;
+        }
+        write_header(
+          output,
+          Header{type, Count(std::in_place_index<3>, static_cast<std::uint32_t>(count))});
+        return true;
+    case 9:
+        write_header(output, Header{type, Count(std::in_place_index<4>, count)});
+        return true;
+    default:
+        return false;
+    }
+}
+} // namespace detail
+
+/** Find the item at path within an encoded buffer without decoding anything
+ * along the way.  Semantic tags wrapping a container are stepped through.
+ * Returns an empty optional if any step is missing or lands on a scalar.
+ */
+inline std::optional<Extent> locate(
+  const std::span<const std::byte> buffer,
+  const std::span<const PathStep> path) {
+    auto begin = buffer.begin();
+    const auto end = buffer.end();
+
+    for (const auto &step : path) {
+        Header header;
+        std::tie(begin, header) = read_header(begin, end);
+        while (header.type == MajorType::SemanticTag) {
+            std::tie(begin, header) = read_header(begin, end);
+        }
+
+        const auto count = header.get_count();
+        bool found = false;
+        switch (header.type) {
+        case MajorType::Array: {
+            if (!step.index()) {
+                return std::nullopt;
+            }
+            const auto index = *step.index();
+            for (std::uint64_t i = 0; i < index; ++i) {
+                if (count ? i >= *count : detail::at_break(begin, end)) {
+                    return std::nullopt;
+                }
+                begin = skip(begin, end);
+            }
+            found = count ? index < *count : !detail::at_break(begin, end);
+            break;
+        }
+        case MajorType::Map: {
+            const auto key = step.key();
+            for (std::uint64_t i = 0; count ? i < *count : !detail::at_break(begin, end); ++i) {
+                const auto key_end = skip(begin, end);
+                const bool matches = std::ranges::equal(std::span(begin, key_end), key);
+                begin = key_end;
+                if (matches) {
+                    found = true;
+                    break;
+                }
+                begin = skip(begin, end);
+            }
+            break;
+        }
+        default: {
+            break;
+        }
+        }
+        if (!found) {
+            return std::nullopt;
+        }
+    }
+
+    const auto item_end = skip(begin, end);
+    return Extent{
+      static_cast<std::size_t>(begin - buffer.begin()),
+      static_cast<std::size_t>(item_end - begin)};
+}
+
+inline std::optional<Extent> locate(
+  const std::span<const std::byte> buffer,
+  const std::initializer_list<PathStep> path) {
+    return locate(buffer, std::span<const PathStep>(path.begin(), path.size()));
+}
+
+/** Overwrite the item at extent with value, but only if value can be encoded
+ * in exactly extent.size bytes.  Integers and floats whose shortest encoding
+ * is smaller are widened to fill the existing header, so a counter can keep
+ * being updated in place.  Returns whether the buffer was modified.
+ */
+inline bool patch_in_place(
+  const std::span<std::byte> buffer,
+  const Extent extent,
+  const Value &value) {
+    if (extent.offset + extent.size > buffer.size()) {
+        throw EndOfInput("Extent reaches past end of buffer");
+    }
+    const auto output = buffer.begin() + extent.offset;
+
+    if (value.encoded_size() == extent.size) {
+        value.encode(output);
+        return true;
+    }
+
+    if (const auto integer = std::get_if<Positive>(&value.value())) {
+        return detail::patch_integer(
+          output,
+          extent.size,
+          MajorType::PositiveInteger,
+          integer->value);
+    }
+    if (const auto integer = std::get_if<Negative>(&value.value())) {
+        return detail::patch_integer(
+          output,
+          extent.size,
+          MajorType::NegativeInteger,
+          integer->count);
+    }
+    if (const auto number = std::get_if<Float>(&value.value())) {
+        const double d = number->value;
+        const float f = static_cast<float>(d);
+        if (extent.size == 5 && (std::isnan(d) || static_cast<double>(f) == d)) {
+            write_header(
+              output,
+              Header{
+                MajorType::SpecialFloat,
+                Count(std::in_place_index<3>, from_be_bytes<std::uint32_t>(to_be_bytes(f)))});
+            return true;
+        }
+        if (extent.size == 9) {
+            write_header(
+              output,
+              Header{
+                MajorType::SpecialFloat,
+                Count(std::in_place_index<4>, from_be_bytes<std::uint64_t>(to_be_bytes(d)))});
+            return true;
+        }
+    }
+    return false;
+}
+
+/** Replace the item at extent with the encoding of value, moving only the
+ * bytes after it.  No enclosing header changes, because one item is replaced
+ * by exactly one item.  Returns the extent of the new item.
+ */
+inline Extent splice(std::vector<std::byte> &buffer, const Extent extent, const Value &value) {
+    if (extent.offset + extent.size > buffer.size()) {
+        throw EndOfInput("Extent reaches past end of buffer");
+    }
+    const auto size = value.encoded_size();
+    const auto item_end = buffer.begin() + extent.offset + extent.size;
+    if (size > extent.size) {
+        buffer.insert(item_end, size - extent.size, std::byte(0));
+    } else if (size < extent.size) {
+        buffer.erase(item_end - (extent.size - size), item_end);
+    }
+    value.encode(buffer.begin() + extent.offset);
+    return Extent{extent.offset, size};
+}
+
+/** Set the item at path to value, in place when it fits and by splicing
+ * otherwise.  Returns false if path does not exist in buffer.
+ */
+inline bool patch(
+  std::vector<std::byte> &buffer,
+  const std::span<const PathStep> path,
+  const Value &value) {
+    const auto extent = locate(buffer, path);
+    if (!extent) {
+        return false;
+    }
+    if (!patch_in_place(buffer, *extent, value)) {
+        splice(buffer, *extent, value);
+    }
+    return true;
+}
+
+inline bool patch(
+  std::vector<std::byte> &buffer,
+  const std::initializer_list<PathStep> path,
+  const Value &value) {
+    return patch(buffer, std::span<const PathStep>(path.begin(), path.size()), value);
+}
+} // namespace varbor
@@ -0,0 +1,515 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+#pragma once
+
+#include <varbor.hxx>
+
+namespace varbor {
+namespace detail {
+struct PersistentMapNode {
+    std::shared_ptr<const Value> key;
+    std::shared_ptr<const Value> value;
+    std::shared_ptr<const PersistentMapNode> left;
+    std::shared_ptr<const PersistentMapNode> right;
+    std::size_t size;
+    int height;
+};
+
+struct PersistentArrayNode {
+    // Inner nodes have children, leaves have values, up to 32 of either.
+    std::vector<std::shared_ptr<const PersistentArrayNode>> children;
+    std::vector<std::shared_ptr<const Value>> values;
+};
+} // namespace detail
+
+/** An immutable sorted map whose updates return a new version sharing all
+ * but O(log n) nodes with the old one, so copying it is an O(1) snapshot.
+ * It is an AVL tree with path copying rather than a hash trie, because Map's
+ * encoding is in key order: entries iterate in that order, and encode to the
+ * same bytes as the equivalent Map.
+ *
+ * Nodes are immutable and reference counted, so snapshots may be read from
+ * any thread while another thread derives new versions.  The values
+ * themselves are ordinary Values, so nested maps are not shared.
+ */
+class PersistentMap {
+  private:
+    using Node = detail::PersistentMapNode;
+    using NodePointer = std::shared_ptr<const Node>;
+
+    NodePointer root_;
+
+    inline explicit PersistentMap(NodePointer root) noexcept : root_(std::move(root)) {
+    }
+
+    static inline int height(const NodePointer &node) noexcept {
+        return node ? node->height : 0;
+    }
+
+    static inline std::size_t size(const NodePointer &node) noexcept {
+        return node ? node->size : 0;
+    }
+
+    static inline NodePointer make(
+      std::shared_ptr<const Value> key,
+      std::shared_ptr<const Value> value,
+      NodePointer left,
+      NodePointer right) {
+        const auto node_size = size(left) + size(right) + 1;
+        const auto node_height = std::max(height(left), height(right)) + 1;
+        return std::make_shared<const Node>(Node{
+          std::move(key),
+          std::move(value),
+          std::move(left),
+          std::move(right),
+          node_size,
+          node_height});
+    }
+
+    /** Make a node, rotating if its subtrees differ in height by two.
+     */
+    static inline NodePointer balance(
+      std::shared_ptr<const Value> key,
+      std::shared_ptr<const Value> value,
+      NodePointer left,
+      NodePointer right) {
+        if (height(left) > height(right) + 1) {
+            if (height(left->left) >= height(left->right)) {
+                return make(
+                  left->key,
+                  left->value,
+                  left->left,
+                  make(std::move(key), std::move(value), left->right, std::move(right)));
+            }
+            const auto &middle = left->right;
+            return make(
+              middle->key,
+              middle->value,
+              make(left->key, left->value, left->left, middle->left),
+              make(std::move(key), std::move(value), middle->right, std::move(right)));
+        }
+        if (height(right) > height(left) + 1) {
+            if (height(right->right) >= height(right->left)) {
+                return make(
+                  right->key,
+                  right->value,
+                  make(std::move(key), std::move(value), std::move(left), right->left),
+                  right->right);
+            }
+            const auto &middle = right->left;
+            return make(
+              middle->key,
+              middle->value,
+              make(std::move(key), std::move(value), std::move(left), middle->left),
+              make(right->key, right->value, middle->right, right->right));
+        }
+        return make(std::move(key), std::move(value), std::move(left), std::move(right));
+    }
+
+    static inline NodePointer set(
+      const NodePointer &node,
+      std::shared_ptr<const Value> key,
+      std::shared_ptr<const Value> value) {
+        if (!node) {
+            return make(std::move(key), std::move(value), nullptr, nullptr);
+        }
+        const auto order = *key <=> *node->key;
+        if (std::is_lt(order)) {
+            return balance(
+              node->key,
+              node->value,
+              set(node->left, std::move(key), std::move(value)),
+              node->right);
+        } else if (std::is_gt(order)) {
+            return balance(
+              node->key,
+              node->value,
+              node->left,
+              set(node->right, std::move(key), std::move(value)));
+        }
+        return make(node->key, std::move(value), node->left, node->right);
+    }
+
+    static inline NodePointer erase_first(const NodePointer &node) {
+        if (!node->left) {
+            return node->right;
+        }
+        return balance(node->key, node->value, erase_first(node->left), node->right);
+    }
+
+    static inline NodePointer erase(const NodePointer &node, const Value &key) {
+        if (!node) {
+            return node;
+        }
+        const auto order = key <=> *node->key;
+        if (std::is_lt(order)) {
+            auto left = erase(node->left, key);
+            if (left == node->left) {
+                return node;
+            }
+            return balance(node->key, node->value, std::move(left), node->right);
+        } else if (std::is_gt(order)) {
+            auto right = erase(node->right, key);
+            if (right == node->right) {
+                return node;
+            }
+            return balance(node->key, node->value, node->left, std::move(right));
+        }
+        if (!node->left) {
+            return node->right;
+        }
+        if (!node->right) {
+            return node->left;
+        }
+        auto first = node->right.get();
+        while (first->left) {
+            first = first->left.get();
+        }
+        return balance(first->key, first->value, node->left, erase_first(node->right));
+    }
+
+    /** Build a balanced tree from sorted entries.
+     */
+    template <typename It>
+    static inline NodePointer build(const It begin, const std::size_t count) {
+        if (count == 0) {
+            return nullptr;
+        }
+        const auto half = count / 2;
+        const auto middle = std::next(begin, static_cast<std::ptrdiff_t>(half));
+        return make(
+          middle->first,
+          middle->second,
+          build(begin, half),
+          build(std::next(middle), count - half - 1));
+    }
+
+  public:
+    /** In-order iterator over the entries.
+     */
+    class Iterator {
+      private:
+        std::vector<const Node *> stack_;
+
+        inline void descend(const Node *node) {
+            for (; node; node = node->left.get()) {
+                stack_.push_back(node);
+            }
+        }
+
+      public:
+        using difference_type = std::ptrdiff_t;
+        using value_type = std::pair<const Value &, const Value &>;
+        using iterator_category = std::forward_iterator_tag;
+
+        Iterator() noexcept = default;
+
+        inline explicit Iterator(const Node *root) {
+            descend(root);
+        }
+
+        inline value_type operator*() const noexcept {
+            return {*stack_.back()->key, *stack_.back()->value};
+        }
+
+        inline Iterator &operator++() {
+            const auto node = stack_.back();
+            stack_.pop_back();
+            descend(node->right.get());
+            return *this;
+        }
+
+        inline Iterator operator++(int) {
+            auto old = *this;
+            ++*this;
+            return old;
+        }
+
+        inline bool operator==(const Iterator &other) const noexcept {
+            return stack_ == other.stack_;
+        }
+    };
+
+    PersistentMap() noexcept = default;
+
+    /** Take over the entries of map.
+     */
+    inline explicit PersistentMap(Map map) {
+        std::vector<std::pair<std::shared_ptr<const Value>, std::shared_ptr<const Value>>>
+          entries;
+        entries.reserve(map.value.size());
+        // Extracted, since the keys of a std::map cannot be moved from
+        while (!map.value.empty()) {
+            auto entry = map.value.extract(map.value.begin());
+            entries.emplace_back(
+              std::make_shared<const Value>(std::move(*entry.key())),
+              std::make_shared<const Value>(std::move(*entry.mapped())));
+        }
+        root_ = build(entries.begin(), entries.size());
+    }
+
+    inline std::size_t size() const noexcept {
+        return size(root_);
+    }
+
+    inline bool empty() const noexcept {
+        return !root_;
+    }
+
+    inline Iterator begin() const {
+        return Iterator(root_.get());
+    }
+
+    inline Iterator end() const noexcept {
+        return Iterator();
+    }
+
+    /** The value for key, or nullptr.
+     */
+    inline const Value *find(const Value &key) const noexcept {
+        for (auto node = root_.get(); node;) {
+            const auto order = key <=> *node->key;
+            if (std::is_lt(order)) {
+                node = node->left.get();
+            } else if (std::is_gt(order)) {
+                node = node->right.get();
+            } else {
+                return node->value.get();
+            }
+        }
+        return nullptr;
+    }
+
+    /** A new version with key set to value.
+     */
+    inline PersistentMap set(Value key, Value value) const {
+        return PersistentMap(set(
+          root_,
+          std::make_shared<const Value>(std::move(key)),
+          std::make_shared<const Value>(std::move(value))));
+    }
+
+    /** A new version without key.
+     */
+    inline PersistentMap erase(const Value &key) const {
+        return PersistentMap(erase(root_, key));
+    }
+
+    template <typename OutputIt>
+    OutputIt encode(OutputIt output) const {
+        output = write_header(output, MajorType::Map, size());
+        for (const auto &[key, value] : *this) {
+            output = key.encode(output);
+            output = value.encode(output);
+        }
+        return output;
+    }
+
+    inline std::vector<std::byte> encode() const {
+        std::vector<std::byte> output;
+        encode(std::back_inserter(output));
+        return output;
+    }
+
+    inline bool operator==(const PersistentMap &other) const {
+        const auto equal = [](const auto &a, const auto &b) {
+            return a.first == b.first && a.second == b.second;
+        };
+        return size() == other.size() && std::equal(begin(), end(), other.begin(), equal);
+    }
+};
+
+/** An immutable array whose updates return a new version sharing all but
+ * O(log n) nodes with the old one, so copying it is an O(1) snapshot.  It is
+ * a 32-way trie with path copying, indexed by the bits of the position, and
+ * encodes to the same bytes as the equivalent Array.
+ *
+ * Like PersistentMap, snapshots may be read from any thread while another
+ * thread derives new versions.
+ */
+class PersistentArray {
+  private:
+    using Node = detail::PersistentArrayNode;
+    using NodePointer = std::shared_ptr<const Node>;
+
+    static constexpr unsigned bits = 5;
+    static constexpr std::size_t width = 1 << bits;
+    static constexpr std::size_t mask = width - 1;
+
+    NodePointer root_;
+    std::size_t size_ = 0;
+
+    // Bit offset of the root's index digit; 0 when the root is a leaf.
+    unsigned shift_ = 0;
+
+    inline PersistentArray(NodePointer root, const std::size_t size, const unsigned shift) noexcept
+        : root_(std::move(root)),
+          size_(size),
+          shift_(shift) {
+    }
+
+    static inline NodePointer set(
+      const NodePointer &node,
+      const unsigned shift,
+      const std::size_t index,
+      std::shared_ptr<const Value> value) {
+        auto copy = std::make_shared<Node>(*node);
+        const auto digit = (index >> shift) & mask;
+        if (shift == 0) {
+            copy->values[digit] = std::move(value);
+        } else {
+            copy->children[digit] = set(node->children[digit], shift - bits, index, value);
+        }
+        return copy;
+    }
+
+    /** Add value at index, which is one past the end of node's subtree.
+     */
+    static inline NodePointer push(
+      const NodePointer &node,
+      const unsigned shift,
+      const std::size_t index,
+      std::shared_ptr<const Value> value) {
+        auto copy = node ? std::make_shared<Node>(*node) : std::make_shared<Node>();
+        if (shift == 0) {
+            copy->values.push_back(std::move(value));
+            return copy;
+        }
+        const auto digit = (index >> shift) & mask;
+        if (digit < copy->children.size()) {
+            copy->children[digit] = push(copy->children[digit], shift - bits, index, value);
+        } else {
+            copy->children.push_back(push(nullptr, shift - bits, index, value));
+        }
+        return copy;
+    }
+
+    /** Remove the element at index, the last one, returning nullptr if
+     * that empties node.
+     */
+    static inline NodePointer pop(
+      const NodePointer &node,
+      const unsigned shift,
+      const std::size_t index) {
+        auto copy = std::make_shared<Node>(*node);
+        if (shift == 0) {
+            copy->values.pop_back();
+            return copy->values.empty() ? nullptr : copy;
+        }
+        const auto digit = (index >> shift) & mask;
+        auto child = pop(copy->children[digit], shift - bits, index);
+        if (child) {
+            copy->children[digit] = std::move(child);
+        } else {
+            copy->children.pop_back();
+        }
+        return copy->children.empty() ? nullptr : copy;
+    }
+
+    template <typename OutputIt>
+    static OutputIt encode(const Node &node, OutputIt output) {
+        for (const auto &value : node.values) {
+            output = value->encode(output);
+        }
+        for (const auto &child : node.children) {
+            output = encode(*child, output);
+        }
+        return output;
+    }
+
+  public:
+    PersistentArray() noexcept = default;
+
+    /** Take over the elements of array.
+     */
+    inline explicit PersistentArray(Array array) {
+        auto built = PersistentArray();
+        for (auto &value : array.value) {
+            built = std::move(built).push_back(std::move(*value));
+        }
+        *this = std::move(built);
+    }
+
+    inline std::size_t size() const noexcept {
+        return size_;
+    }
+
+    inline bool empty() const noexcept {
+        return size_ == 0;
+    }
+
+    inline const Value &operator[](const std::size_t index) const noexcept {
+        auto node = root_.get();
+        for (auto shift = shift_; shift > 0; shift -= bits) {
+            node = node->children[(index >> shift) & mask].get();
+        }
+        return *node->values[index & mask];
+    }
+
+    /** A new version with the element at index replaced.
+     */
+    inline PersistentArray set(const std::size_t index, Value value) const {
+        if (index >= size_) {
+            throw std::out_of_range("PersistentArray index out of range");
+        }
+        return PersistentArray(
+          set(root_, shift_, index, std::make_shared<const Value>(std::move(value))),
+          size_,
+          shift_);
+    }
+
+    /** A new version with value appended.
+     */
+    inline PersistentArray push_back(Value value) const {
+        auto element = std::make_shared<const Value>(std::move(value));
+        if (!root_) {
+            return PersistentArray(push(nullptr, 0, 0, std::move(element)), 1, 0);
+        }
+        if (size_ == std::size_t(1) << (shift_ + bits)) {
+            // Full: grow a level, with the old root as the first child.
+            auto root = std::make_shared<Node>();
+            root->children.push_back(root_);
+            return PersistentArray(
+              push(root, shift_ + bits, size_, std::move(element)),
+              size_ + 1,
+              shift_ + bits);
+        }
+        return PersistentArray(push(root_, shift_, size_, std::move(element)), size_ + 1, shift_);
+    }
+
+    /** A new version without the last element.
+     */
+    inline PersistentArray pop_back() const {
+        if (empty()) {
+            throw std::out_of_range("pop_back on empty PersistentArray");
+        }
+        if (size_ == 1) {
+            return PersistentArray();
+        }
+        auto root = pop(root_, shift_, size_ - 1);
+        auto shift = shift_;
+        // Drop levels left with a single child.
+        while (shift > 0 && root->children.size() == 1) {
+            root = root->children.front();
+            shift -= bits;
+        }
+        return PersistentArray(std::move(root), size_ - 1, shift);
+    }
+
+    template <typename OutputIt>
+    OutputIt encode(OutputIt output) const {
+        output = write_header(output, MajorType::Array, size_);
+        if (root_) {
+            output = encode(*root_, output);
+        }
+        return output;
+    }
+
+    inline std::vector<std::byte> encode() const {
+        std::vector<std::byte> output;
+        encode(std::back_inserter(output));
+        return output;
+    }
+};
+} // namespace varbor
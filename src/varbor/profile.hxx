@@ -0,0 +1,242 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+#pragma once
+
+#include <varbor.hxx>
+
+#include <chrono>
+#include <cstdio>
+#include <ostream>
+
+namespace varbor {
+/** What a profile gathered for one document path.
+ */
+struct PathProfile {
+    // Encoded bytes of every item at this path, including headers.
+    std::uint64_t bytes = 0;
+
+    // Number of items at this path.
+    std::uint64_t items = 0;
+
+    // Time spent decoding items at this path, including their children.
+    std::chrono::nanoseconds time{0};
+
+    bool operator==(const PathProfile &other) const noexcept = default;
+};
+
+/** Encoded size, item count and decode time aggregated by document path.
+ *
+ * The top-level item is "$".  A map value extends its map's path with
+ * ".key" for text and integer keys and ".?" for any other key, and an array
+ * element with "[*]", so every element of an array is aggregated together.
+ */
+class Profile {
+  private:
+    std::map<std::string, PathProfile, std::less<>> paths_;
+
+  public:
+    inline const std::map<std::string, PathProfile, std::less<>> &paths() const noexcept {
+        return paths_;
+    }
+
+    /** Add one item at path.
+     */
+    inline void add(
+      const std::string_view path,
+      const std::uint64_t bytes,
+      const std::chrono::nanoseconds time) {
+        auto found = paths_.find(path);
+        if (found == paths_.end()) {
+            found = paths_.emplace(std::string(path), PathProfile{}).first;
+        }
+        found->second.bytes += bytes;
+        ++found->second.items;
+        found->second.time += time;
+    }
+
+    /** Paths ordered by encoded bytes, largest first.
+     */
+    inline std::vector<std::pair<std::string, PathProfile>> sorted() const {
+        std::vector<std::pair<std::string, PathProfile>> output(paths_.begin(), paths_.end());
+        std::stable_sort(output.begin(), output.end(), [](const auto &a, const auto &b) {
+            return a.second.bytes > b.second.bytes;
+        });
+        return output;
+    }
+
+    /** Write sorted() as a table of bytes, items, nanoseconds and path.
+     */
+    inline void report(std::ostream &output) const {
+        char line[64];
+        std::snprintf(line, sizeof(line), "%14s %10s %14s  ", "bytes", "items", "nanoseconds");
+        output << line << "path\n";
+        for (const auto &[path, profile] : sorted()) {
+            std::snprintf(
+              line,
+              sizeof(line),
+              "%14llu %10llu %14lld  ",
+              static_cast<unsigned long long>(profile.bytes),
+              static_cast<unsigned long long>(profile.items),
+              static_cast<long long>(profile.time.count()));
+            output << line << path << '\n';
+        }
+    }
+
+    /** The profile as a map from path to a map of "bytes", "items" and
+     * "nanoseconds", ready to encode.
+     */
+    inline Value to_value() const {
+        std::map<ValuePointer, ValuePointer, std::less<>> output;
+        for (const auto &[path, profile] : paths_) {
+            std::map<ValuePointer, ValuePointer, std::less<>> fields;
+            fields.emplace(
+              std::make_unique<Value>(u8"bytes"),
+              std::make_unique<Value>(profile.bytes));
+            fields.emplace(
+              std::make_unique<Value>(u8"items"),
+              std::make_unique<Value>(profile.items));
+            fields.emplace(
+              std::make_unique<Value>(u8"nanoseconds"),
+              std::make_unique<Value>(static_cast<std::int64_t>(profile.time.count())));
+            output.emplace(
+              std::make_unique<Value>(
+                std::u8string(reinterpret_cast<const char8_t *>(path.data()), path.size())),
+              std::make_unique<Value>(Map(std::move(fields))));
+        }
+        return Value(Map(std::move(output)));
+    }
+};
+
+namespace detail {
+/** Instrumentation that attributes every decoded item to its path in a
+ * Profile, and passes every hook on to Inner too.  Array elements and map
+ * values are attributed, and map keys and everything inside a string or a
+ * tag are counted in their parent.
+ */
+template <typename Inner>
+struct ProfileInstrument : Inner {
+    static constexpr bool enabled = true;
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Frame {
+        Clock::time_point start;
+        MajorType type;
+        // Length of State::path while it holds this item's path.
+        std::size_t path;
+        bool attributed;
+        std::uint64_t children = 0;
+        // For a map, the path segment of the key just decoded.
+        std::string key{};
+    };
+
+    struct State {
+        Profile *profile = nullptr;
+        std::string path;
+        std::vector<Frame> frames;
+    };
+
+    static inline State &state() noexcept {
+        thread_local State state;
+        return state;
+    }
+
+    static inline void enter(const MajorType type) {
+        Inner::enter(type);
+        auto &state = ProfileInstrument::state();
+        bool attributed = true;
+        if (state.frames.empty()) {
+            state.path = "$";
+        } else {
+            auto &parent = state.frames.back();
+            // Map keys come at even indices, and values at odd ones.
+            const auto index = parent.children++;
+            attributed = parent.attributed &&
+              (parent.type == MajorType::Array ||
+               (parent.type == MajorType::Map && index % 2 == 1));
+            if (attributed) {
+                state.path.resize(parent.path);
+                state.path += parent.type == MajorType::Array ? "[*]" : parent.key;
+            }
+        }
+        state.frames.push_back(Frame{Clock::now(), type, state.path.size(), attributed});
+    }
+
+    static inline void leave(const Value &value, const std::size_t bytes) {
+        Inner::leave(value, bytes);
+        auto &state = ProfileInstrument::state();
+        const auto frame = std::move(state.frames.back());
+        state.frames.pop_back();
+        if (frame.attributed && !std::holds_alternative<Break>(value.value())) {
+            state.profile->add(
+              std::string_view(state.path).substr(0, frame.path),
+              bytes,
+              std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - frame.start));
+        }
+        if (!state.frames.empty()) {
+            auto &parent = state.frames.back();
+            if (parent.type == MajorType::Map && parent.attributed && parent.children % 2 == 1) {
+                parent.key = segment(value);
+            }
+        }
+    }
+
+    /** The path segment for a map key.
+     */
+    static inline std::string segment(const Value &key) {
+        std::string output(".");
+        if (const auto string = std::get_if<Utf8String>(&key.value())) {
+            const std::u8string_view view = *string;
+            output.append(reinterpret_cast<const char *>(view.data()), view.size());
+        } else if (const auto integer = key.as_int64()) {
+            output += std::to_string(*integer);
+        } else {
+            output += '?';
+        }
+        return output;
+    }
+};
+
+/** Policy decoding exactly like Policy, while profiling into the profile set
+ * in ProfileInstrument's state.
+ */
+template <typename Policy>
+struct ProfilePolicy : Policy {
+    using instrument = ProfileInstrument<typename Policy::instrument>;
+};
+} // namespace detail
+
+/** Decode one item like Value::decode, adding the encoded size, count and
+ * decode time of every item to profile by its path.  Strings, scalars and
+ * tagged items are attributed whole to their path.  Decoding goes through the
+ * same Decoder as Value::decode, with Policy's instrument still called.
+ * Timing every item slows the decode down, so this is for finding what
+ * dominates a document, not for production decoding.
+ */
+template <typename Policy = DecodePolicy, std::random_access_iterator InputIt>
+inline std::tuple<InputIt, Value> profile_decode(
+  const InputIt begin,
+  const InputIt end,
+  Profile &profile) {
+    using Instrument = typename detail::ProfilePolicy<Policy>::instrument;
+    auto &state = Instrument::state();
+    // Reset afterwards, so a decode that throws leaves no frames behind.
+    struct Reset {
+        typename Instrument::State &state;
+
+        inline ~Reset() {
+            state.profile = nullptr;
+            state.frames.clear();
+        }
+    } reset{state};
+    state.profile = &profile;
+    state.frames.clear();
+    return Value::decode<detail::ProfilePolicy<Policy>>(begin, end);
+}
+
+template <typename Policy = DecodePolicy>
+inline Value profile_decode(const std::span<const std::byte> input, Profile &profile) {
+    return std::get<1>(profile_decode<Policy>(input.begin(), input.end(), profile));
+}
+} // namespace varbor
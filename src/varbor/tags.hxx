@@ -0,0 +1,295 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+#pragma once
+
+#include <varbor.hxx>
+
+#include <chrono>
+#include <cmath>
+
+namespace varbor {
+/** The time as a std::chrono time point.
+ */
+inline auto DateTime::time() const noexcept {
+    return std::chrono::sys_time<std::chrono::nanoseconds>(std::chrono::nanoseconds(nanoseconds));
+}
+
+/** The UTC offset tag 0 was written with.
+ */
+inline auto DateTime::offset() const noexcept {
+    return std::chrono::minutes(offset_minutes);
+}
+
+namespace detail {
+/** Parse an RFC 3339 date-time, returning the UTC time and the offset it was
+ * written with, or nothing if it is invalid or outside the range of
+ * std::chrono::sys_time<std::chrono::nanoseconds>.
+ */
+inline std::optional<
+  std::pair<std::chrono::sys_time<std::chrono::nanoseconds>, std::chrono::minutes>>
+parse_rfc3339(const std::u8string_view input) {
+    std::size_t position = 0;
+    const auto digits = [&](const std::size_t count) -> std::optional<int> {
+        if (position + count > input.size()) {
+            return std::nullopt;
+        }
+        int value = 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            const auto c = input[position + i];
+            if (c < u8'0' || c > u8'9') {
+                return std::nullopt;
+            }
+            value = value * 10 + (c - u8'0');
+        }
+        position += count;
+        return value;
+    };
+    const auto literal = [&](const std::u8string_view options) {
+        if (position < input.size() && options.find(input[position]) != options.npos) {
+            ++position;
+            return true;
+        }
+        return false;
+    };
+
+    const auto year = digits(4);
+    if (!year || !literal(u8"-")) {
+        return std::nullopt;
+    }
+    const auto month = digits(2);
+    if (!month || !literal(u8"-")) {
+        return std::nullopt;
+    }
+    const auto day = digits(2);
+    if (!day || !literal(u8"Tt ")) {
+        return std::nullopt;
+    }
+    const auto hour = digits(2);
+    if (!hour || !literal(u8":")) {
+        return std::nullopt;
+    }
+    const auto minute = digits(2);
+    if (!minute || !literal(u8":")) {
+        return std::nullopt;
+    }
+    const auto second = digits(2);
+    if (!second || *hour > 23 || *minute > 59 || *second > 59) {
+        return std::nullopt;
+    }
+
+    std::chrono::nanoseconds fraction{0};
+    if (literal(u8".")) {
+        std::int64_t scale = 100000000;
+        const auto start = position;
+        for (; position < input.size() && input[position] >= u8'0' && input[position] <= u8'9';
+             ++position) {
+            fraction += std::chrono::nanoseconds((input[position] - u8'0') * scale);
+            scale /= 10;
+        }
+        if (position == start) {
+            return std::nullopt;
+        }
+    }
+
+    std::chrono::minutes offset{0};
+    if (!literal(u8"Zz")) {
+        const bool negative = position < input.size() && input[position] == u8'-';
+        if (!literal(u8"+-")) {
+            return std::nullopt;
+        }
+        const auto offset_hours = digits(2);
+        if (!offset_hours || !literal(u8":")) {
+            return std::nullopt;
+        }
+        const auto offset_minutes = digits(2);
+        if (!offset_minutes || *offset_hours > 23 || *offset_minutes > 59) {
+            return std::nullopt;
+        }
+        offset = std::chrono::hours(*offset_hours) + std::chrono::minutes(*offset_minutes);
+        if (negative) {
+            offset = -offset;
+        }
+    }
+    if (position != input.size()) {
+        return std::nullopt;
+    }
+
+    const std::chrono::year_month_day date{
+      std::chrono::year(*year),
+      std::chrono::month(static_cast<unsigned>(*month)),
+      std::chrono::day(static_cast<unsigned>(*day))};
+    if (!date.ok()) {
+        return std::nullopt;
+    }
+    const auto seconds = std::chrono::sys_days(date) + std::chrono::hours(*hour) +
+      std::chrono::minutes(*minute) + std::chrono::seconds(*second);
+    // Both the local and UTC times, plus under a second of fraction, must fit
+    // in int64 nanoseconds.
+    constexpr std::int64_t limit = std::numeric_limits<std::int64_t>::max() / 1000000000;
+    for (const auto time : {seconds, seconds - offset}) {
+        if (std::abs(time.time_since_epoch().count()) >= limit) {
+            return std::nullopt;
+        }
+    }
+    const auto local = std::chrono::sys_time<std::chrono::nanoseconds>(seconds) + fraction;
+    return std::make_pair(local - offset, offset);
+}
+} // namespace detail
+
+/** Tags 0 and 1 into DateTime.  Times outside the range of
+ * std::chrono::sys_time<std::chrono::nanoseconds>, about 292 years either
+ * side of 1970, stay generic, as does any payload DateTime would not encode
+ * back to exactly: a tag 0 string not in the form format_rfc3339 writes
+ * (leap seconds, lowercase letters, "+00:00", trailing fraction zeros), and
+ * a tag 1 float that is a whole number of seconds or not a whole number of
+ * nanoseconds.
+ */
+struct DateTimeTag {
+    static constexpr std::array<std::uint64_t, 2> ids{0, 1};
+
+    static inline std::optional<Value> decode(const std::uint64_t id, Value &payload) {
+        using std::chrono::nanoseconds;
+        constexpr std::int64_t limit = std::numeric_limits<std::int64_t>::max() / 1000000000;
+
+        if (id == 0) {
+            const auto string = std::get_if<Utf8String>(&payload.value());
+            if (!string) {
+                return std::nullopt;
+            }
+            const auto parsed = detail::parse_rfc3339(*string);
+            if (!parsed) {
+                return std::nullopt;
+            }
+            const DateTime time{
+              0,
+              parsed->first.time_since_epoch().count(),
+              static_cast<std::int32_t>(parsed->second.count())};
+            detail::Rfc3339Buffer buffer;
+            if (
+              detail::format_rfc3339(buffer, time.nanoseconds, time.offset_minutes) !=
+              static_cast<std::u8string_view>(*string)) {
+                return std::nullopt;
+            }
+            return Value(time);
+        }
+
+        std::optional<nanoseconds> since_epoch;
+        if (const auto positive = std::get_if<Positive>(&payload.value())) {
+            if (positive->value < static_cast<std::uint64_t>(limit)) {
+                since_epoch = std::chrono::seconds(static_cast<std::int64_t>(positive->value));
+            }
+        } else if (const auto negative = std::get_if<Negative>(&payload.value())) {
+            if (negative->count < static_cast<std::uint64_t>(limit)) {
+                since_epoch = std::chrono::seconds(static_cast<std::int64_t>(*negative));
+            }
+        } else if (const auto number = std::get_if<Float>(&payload.value())) {
+            if (std::isfinite(number->value) && std::abs(number->value) < limit) {
+                const auto rounded =
+                  std::chrono::round<nanoseconds>(std::chrono::duration<double>(number->value));
+                if (
+                  rounded % std::chrono::seconds(1) != nanoseconds(0) &&
+                  std::chrono::duration<double>(rounded).count() == number->value) {
+                    since_epoch = rounded;
+                }
+            }
+        }
+        if (!since_epoch) {
+            return std::nullopt;
+        }
+        return Value(DateTime{1, since_epoch->count(), 0});
+    }
+};
+
+/** Tags 2 and 3 into BigNum, when the magnitude fits in 128 bits.  BigNum
+ * encodes minimal bytes, so a payload with leading zero bytes stays generic.
+ */
+struct BigNumTag {
+    static constexpr std::array<std::uint64_t, 2> ids{2, 3};
+
+    static inline std::optional<Value> decode(const std::uint64_t id, Value &payload) {
+        const auto string = std::get_if<ByteString>(&payload.value());
+        if (!string) {
+            return std::nullopt;
+        }
+        const std::span<const std::byte> bytes = *string;
+        if (bytes.size() > 16 || (!bytes.empty() && bytes.front() == std::byte(0))) {
+            return std::nullopt;
+        }
+        BigNum output{id == 3, 0, 0};
+        for (const auto byte : bytes) {
+            output.high = (output.high << 8) | (output.low >> 56);
+            output.low = (output.low << 8) | static_cast<std::uint64_t>(byte);
+        }
+        return Value(output);
+    }
+};
+
+/** Tags 4 and 5 into DecimalFraction, when both parts are 64-bit integers.
+ */
+struct DecimalFractionTag {
+    static constexpr std::array<std::uint64_t, 2> ids{4, 5};
+
+    static inline std::optional<Value> decode(const std::uint64_t id, Value &payload) {
+        const auto array = std::get_if<Array>(&payload.value());
+        if (!array || array->value.size() != 2) {
+            return std::nullopt;
+        }
+        const auto as_int64 = [](const Value &value) -> std::optional<std::int64_t> {
+            if (const auto positive = std::get_if<Positive>(&value.value())) {
+                if (positive->is_valid_int64()) {
+                    return static_cast<std::int64_t>(*positive);
+                }
+            } else if (const auto negative = std::get_if<Negative>(&value.value())) {
+                if (negative->is_valid_int64()) {
+                    return static_cast<std::int64_t>(*negative);
+                }
+            }
+            return std::nullopt;
+        };
+        const auto exponent = as_int64(*array->value[0]);
+        const auto mantissa = as_int64(*array->value[1]);
+        if (!exponent || !mantissa) {
+            return std::nullopt;
+        }
+        return Value(DecimalFraction{id, *exponent, *mantissa});
+    }
+};
+
+/** Tag 37 into Uuid.
+ */
+struct UuidTag {
+    static constexpr std::array<std::uint64_t, 1> ids{37};
+
+    static inline std::optional<Value> decode(const std::uint64_t, Value &payload) {
+        const auto string = std::get_if<ByteString>(&payload.value());
+        if (!string) {
+            return std::nullopt;
+        }
+        const std::span<const std::byte> bytes = *string;
+        if (bytes.size() != 16) {
+            return std::nullopt;
+        }
+        Uuid output;
+        std::ranges::copy(bytes, output.bytes.begin());
+        return Value(output);
+    }
+};
+
+/** Tag 24 into EmbeddedCbor.
+ */
+struct EmbeddedCborTag {
+    static constexpr std::array<std::uint64_t, 1> ids{24};
+
+    static inline std::optional<Value> decode(const std::uint64_t, Value &payload) {
+        const auto string = std::get_if<ByteString>(&payload.value());
+        if (!string) {
+            return std::nullopt;
+        }
+        return Value(EmbeddedCbor{std::move(*string)});
+    }
+};
+
+using StandardTags =
+  TagRegistry<DateTimeTag, BigNumTag, DecimalFractionTag, UuidTag, EmbeddedCborTag>;
+} // namespace varbor
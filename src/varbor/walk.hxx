@@ -0,0 +1,312 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+#pragma once
+
+#include <varbor.hxx>
+
+namespace varbor {
+/** One step from a container down to one of its children.
+ */
+struct Step {
+    /** The child's position among its siblings, in iteration order.
+     */
+    std::size_t index = 0;
+
+    /** The child's key, for a map entry, or nullptr for an array element or
+     * a tagged value.
+     */
+    const Value *key = nullptr;
+
+    bool operator==(const Step &other) const noexcept = default;
+};
+
+/** Whether a cursor is on its way into a node or out of it.
+ */
+enum class CursorEvent {
+    Enter,
+    Leave,
+};
+
+namespace detail {
+/** Values for IntMap's small keys, by slot, so paths can point at them.
+ */
+inline const Value &int_map_key(const std::size_t slot) {
+    static const auto keys = [] {
+        constexpr auto slots = static_cast<std::size_t>(IntMap::max_key - IntMap::min_key + 1);
+        std::vector<Value> keys;
+        keys.reserve(slots);
+        for (std::size_t slot = 0; slot < slots; ++slot) {
+            keys.emplace_back(IntMap::key(slot));
+        }
+        return keys;
+    }();
+    return keys[slot];
+}
+} // namespace detail
+
+/** Non-recursive depth-first walk over a Value tree, reporting an Enter event
+ * for every node before its children, and a Leave event after them.  The
+ * cursor starts on the root's Enter event, and next() moves to the following
+ * event, returning false after the root's Leave.  Stack depth stays constant
+ * however deep the tree is.
+ *
+ * Children are, in order, array elements, map values, IntMap values by slot
+ * then the rest, and a semantic tag's tagged value.  Map keys are not visited
+ * as nodes, but appear in the path.
+ *
+ * V is Value or const Value.  With a mutable cursor, a node may be modified
+ * or replaced on its Enter event, before its children are listed, and freely
+ * on its Leave event, but no container above it may be changed.
+ */
+template <typename V>
+class BasicCursor {
+  public:
+    using Event = CursorEvent;
+
+  private:
+    using MapIterator = std::conditional_t<
+      std::is_const_v<V>,
+      decltype(Map::value)::const_iterator,
+      decltype(Map::value)::iterator>;
+
+    struct Frame {
+        V *value;
+        // Children listed so far.
+        std::size_t next = 0;
+        // The next IntMap slot to look at.
+        std::size_t slot = 0;
+        // The next entry of a Map, or of an IntMap's rest.
+        MapIterator position{};
+    };
+
+    std::vector<Frame> frames_;
+    std::vector<Step> path_;
+    std::size_t prefix_;
+    V *current_;
+    Event event_ = Event::Enter;
+    bool skip_ = false;
+    // Whether the bottom frame is a Range, which lists only remaining_ more
+    // children and is never left.
+    bool range_ = false;
+    std::size_t remaining_ = 0;
+
+    /** The frame's next child, setting step to reach it, or nullptr.
+     */
+    static inline V *child(Frame &frame, Step &step) {
+        auto &variant = frame.value->value();
+        if (const auto array = std::get_if<Array>(&variant)) {
+            if (frame.next == array->value.size()) {
+                return nullptr;
+            }
+            step = {frame.next, nullptr};
+            return &*array->value[frame.next++];
+        } else if (const auto map = std::get_if<Map>(&variant)) {
+            if (frame.next == 0) {
+                frame.position = map->value.begin();
+            }
+            if (frame.position == map->value.end()) {
+                return nullptr;
+            }
+            step = {frame.next++, &*frame.position->first};
+            return &*(frame.position++)->second;
+        } else if (const auto ordered = std::get_if<OrderedMap>(&variant)) {
+            if (frame.next == ordered->value.size()) {
+                return nullptr;
+            }
+            auto &[key, value] = ordered->value[frame.next];
+            step = {frame.next++, &*key};
+            return &*value;
+        } else if (const auto int_map = std::get_if<IntMap>(&variant)) {
+            // Slots first, then rest, whose entries start once slot is past
+            // the end of slots.
+            if (frame.slot <= int_map->slots.size()) {
+                while (frame.slot < int_map->slots.size() &&
+                       !static_cast<const std::unique_ptr<Value> &>(int_map->slots[frame.slot])) {
+                    ++frame.slot;
+                }
+                if (frame.slot < int_map->slots.size()) {
+                    step = {frame.next++, &detail::int_map_key(frame.slot)};
+                    return &*int_map->slots[frame.slot++];
+                }
+                frame.slot = int_map->slots.size() + 1;
+                frame.position = int_map->rest.value.begin();
+            }
+            if (frame.position == int_map->rest.value.end()) {
+                return nullptr;
+            }
+            step = {frame.next++, &*frame.position->first};
+            return &*(frame.position++)->second;
+        } else if (const auto tag = std::get_if<SemanticTag>(&variant)) {
+            if (frame.next == 1) {
+                return nullptr;
+            }
+            step = {frame.next++, nullptr};
+            return &*tag->value;
+        }
+        return nullptr;
+    }
+
+    /** Move the frame past count children, without stepping through the
+     * children of arrays and OrderedMaps.
+     */
+    static inline void advance(Frame &frame, const std::size_t count) {
+        const auto &variant = frame.value->value();
+        if (std::holds_alternative<Array>(variant) || std::holds_alternative<OrderedMap>(variant)) {
+            frame.next += count;
+            return;
+        }
+        Step step;
+        for (std::size_t i = 0; i < count; ++i) {
+            child(frame, step);
+        }
+    }
+
+  public:
+    /** A run of consecutive children of one container, made by split(), for
+     * walking with a cursor of its own.
+     */
+    class Range {
+        friend BasicCursor;
+
+        Frame frame_;
+        std::size_t size_;
+
+        inline Range(const Frame &frame, const std::size_t size) noexcept :
+            frame_(frame),
+            size_(size) {
+        }
+
+      public:
+        inline std::size_t size() const noexcept {
+            return size_;
+        }
+    };
+
+    /** The number of children the cursor visits under node.
+     */
+    static inline std::size_t children(const Value &node) noexcept {
+        const auto &variant = node.value();
+        if (const auto array = std::get_if<Array>(&variant)) {
+            return array->value.size();
+        } else if (const auto map = std::get_if<Map>(&variant)) {
+            return map->value.size();
+        } else if (const auto ordered = std::get_if<OrderedMap>(&variant)) {
+            return ordered->value.size();
+        } else if (const auto int_map = std::get_if<IntMap>(&variant)) {
+            return int_map->size();
+        }
+        return std::holds_alternative<SemanticTag>(variant) ? 1 : 0;
+    }
+
+    /** Split the children of container into runs of size children, the last
+     * possibly shorter, in order.  Arrays and OrderedMaps are split without
+     * touching their children; maps are stepped through once.
+     */
+    static inline std::vector<Range> split(V &container, const std::size_t size) {
+        const auto count = children(container);
+        std::vector<Range> ranges;
+        ranges.reserve((count + size - 1) / size);
+        Frame frame{&container};
+        for (std::size_t first = 0; first < count; first += size) {
+            ranges.push_back(Range(frame, std::min(size, count - first)));
+            advance(frame, ranges.back().size());
+        }
+        return ranges;
+    }
+
+    /** Start on root's Enter event.  prefix is prepended to every path, for
+     * walking a subtree as part of a larger one.
+     */
+    inline explicit BasicCursor(V &root, std::vector<Step> prefix = {}) :
+        path_(std::move(prefix)),
+        prefix_(path_.size()),
+        current_(&root) {
+    }
+
+    /** Walk the children in range, each as a subtree at depth 1, and never
+     * the container itself.  prefix is the path to the container.  Starts on
+     * the first child's Enter event, and next() returns false after the last
+     * child's Leave.  range must not be empty.
+     */
+    inline BasicCursor(const Range &range, std::vector<Step> prefix) :
+        frames_{range.frame_},
+        path_(std::move(prefix)),
+        prefix_(path_.size()),
+        range_(true),
+        remaining_(range.size_ - 1) {
+        Step step;
+        current_ = child(frames_.back(), step);
+        path_.push_back(step);
+    }
+
+    inline Event event() const noexcept {
+        return event_;
+    }
+
+    /** The node of the current event.
+     */
+    inline V &value() const noexcept {
+        return *current_;
+    }
+
+    /** The steps from the root, after any prefix, to the current node.
+     */
+    inline std::span<const Step> path() const noexcept {
+        return path_;
+    }
+
+    /** How far the current node is below the root.
+     */
+    inline std::size_t depth() const noexcept {
+        return path_.size() - prefix_;
+    }
+
+    /** On an Enter event, skip the node's children, so the next event is the
+     * node's Leave.
+     */
+    inline void skip() noexcept {
+        skip_ = event_ == Event::Enter;
+    }
+
+    /** Move to the next event.  Returns false once the walk is over.
+     */
+    inline bool next() {
+        if (event_ == Event::Enter) {
+            if (skip_) {
+                skip_ = false;
+                event_ = Event::Leave;
+                return true;
+            }
+            frames_.push_back(Frame{current_});
+        } else if (frames_.empty()) {
+            return false;
+        } else {
+            path_.pop_back();
+        }
+
+        auto &frame = frames_.back();
+        if (range_ && frames_.size() == 1) {
+            if (remaining_ == 0) {
+                frames_.clear();
+                return false;
+            }
+            --remaining_;
+        }
+        Step step;
+        if (const auto child = BasicCursor::child(frame, step)) {
+            path_.push_back(step);
+            current_ = child;
+            event_ = Event::Enter;
+        } else {
+            current_ = frame.value;
+            frames_.pop_back();
+            event_ = Event::Leave;
+        }
+        return true;
+    }
+};
+
+using Cursor = BasicCursor<const Value>;
+using MutableCursor = BasicCursor<Value>;
+} // namespace varbor
@@ -0,0 +1,75 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+
+#include <varbor.hxx>
+
+struct Ordered : varbor::DecodePolicy {
+    static constexpr bool preserve_map_order = true;
+};
+
+struct SmallInts : varbor::DecodePolicy {
+    static constexpr bool small_int_maps = true;
+};
+
+int main() {
+    if (varbor::Value(-5).as_int64() != -5 || varbor::Value(5).as_uint64() != 5u ||
+        varbor::Value(-5).as_uint64() || varbor::Value(u8"5").as_int64()) {
+        throw std::runtime_error("integers");
+    }
+    const auto min = std::numeric_limits<std::int64_t>::min();
+    if (varbor::Value(min).as_int64() != min ||
+        varbor::Value(varbor::Negative(std::numeric_limits<std::uint64_t>::max())).as_int64() ||
+        varbor::Value(std::numeric_limits<std::uint64_t>::max()).as_int64()) {
+        throw std::runtime_error("int64 range");
+    }
+    if (varbor::Value(2.5).as_double() != 2.5 || varbor::Value(2).as_double() ||
+        varbor::Value(true).as_bool() != true) {
+        throw std::runtime_error("scalars");
+    }
+
+    // {"a": [0, 1, 2, {"b": "found"}], -3: h'01'}
+    varbor::Map inner;
+    inner.value.emplace(
+      std::make_unique<varbor::Value>(u8"b"),
+      std::make_unique<varbor::Value>(u8"found"));
+    varbor::Array array;
+    for (int i = 0; i < 3; ++i) {
+        array.value.push_back(std::make_unique<varbor::Value>(i));
+    }
+    array.value.push_back(std::make_unique<varbor::Value>(std::move(inner)));
+    varbor::Map outer;
+    outer.value.emplace(
+      std::make_unique<varbor::Value>(u8"a"),
+      std::make_unique<varbor::Value>(std::move(array)));
+    outer.value.emplace(
+      std::make_unique<varbor::Value>(-3),
+      std::make_unique<varbor::Value>(std::vector<std::byte>{std::byte(1)}));
+    const varbor::Value value(std::move(outer));
+    const auto encoded = value.encode();
+
+    for (const auto &decoded :
+         {varbor::Value::decode(encoded),
+          varbor::Value::decode<Ordered>(encoded),
+          varbor::Value::decode<SmallInts>(encoded)}) {
+        if (decoded[u8"a"][3][u8"b"].as_string() != u8"found") {
+            throw std::runtime_error("chained lookup");
+        }
+        if (decoded[-3].as_bytes()->size() != 1 || decoded[u8"a"][2].as_int64() != 2) {
+            throw std::runtime_error("lookup");
+        }
+        if (&decoded[u8"a"][4][u8"b"] != &varbor::Value::missing() ||
+            &decoded[u8"a"][-1] != &varbor::Value::missing() ||
+            &decoded[u8"x"][0] != &varbor::Value::missing() ||
+            &decoded[7] != &varbor::Value::missing() ||
+            &decoded[u8"a"][0][0] != &varbor::Value::missing()) {
+            throw std::runtime_error("missing lookup");
+        }
+    }
+
+    if (value.as_map()->size() != 2 || value[u8"a"].as_array()->size() != 4 ||
+        value[u8"a"].as_map() != nullptr || value.as_array() != nullptr) {
+        throw std::runtime_error("containers");
+    }
+    return 0;
+}
@@ -0,0 +1,180 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+
+#include <varbor.hxx>
+#include <varbor/instrument.hxx>
+
+#include <chrono>
+#include <functional>
+#include <list>
+
+// Each family of expensive inputs is decoded at two sizes, and the larger
+// must not cost much more than its share of memory, copying and key
+// comparisons, as counted by Instrumented.  A quadratic decoder would do 64
+// times the work on an input 8 times the size.  With --timing, wall-clock
+// time is checked the same way; that is too noisy for loaded or sanitized
+// builds, so ctest only runs it with VARBOR_TIMING_TESTS.
+
+struct Counted : varbor::DecodePolicy {
+    using instrument = varbor::Instrumented;
+};
+
+constexpr std::size_t small = 1024;
+constexpr std::size_t scale = 8;
+
+bool timing = false;
+
+std::chrono::nanoseconds fastest(const std::vector<std::byte> &input) {
+    auto best = std::chrono::nanoseconds::max();
+    for (int i = 0; i < 3; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        const auto value = varbor::Value::decode(input);
+        const auto time = std::chrono::steady_clock::now() - start;
+        best = std::min(best, std::chrono::duration_cast<std::chrono::nanoseconds>(time));
+    }
+    return best;
+}
+
+varbor::Statistics counted(const std::vector<std::byte> &input) {
+    varbor::Instrumented::take();
+    varbor::Value::decode<Counted>(input);
+    return varbor::Instrumented::take();
+}
+
+void grew(
+  const char *name,
+  const char *what,
+  const double larger,
+  const double smaller,
+  const double limit) {
+    const auto ratio = larger / std::max(smaller, 1.0);
+    if (ratio > limit) {
+        throw std::runtime_error(
+          std::string(name) + " decode " + what + " grew " + std::to_string(ratio) + " times");
+    }
+}
+
+void check(const char *name, const std::function<std::vector<std::byte>(std::size_t)> &generate) {
+    const auto smaller = generate(small);
+    const auto larger = generate(small * scale);
+
+    const auto before = counted(smaller);
+    const auto after = counted(larger);
+    grew(name, "memory", after.allocated_bytes, before.allocated_bytes, scale * 1.5);
+    grew(name, "copying", after.bytes_copied, before.bytes_copied, scale * 1.5);
+    // Sorting n keys takes n log n comparisons, 10.4 times as many here.
+    grew(name, "comparisons", after.map_comparisons, before.map_comparisons, scale * 2);
+
+    if (timing) {
+        grew(
+          name,
+          "time",
+          static_cast<double>(fastest(larger).count()),
+          static_cast<double>(fastest(smaller).count()),
+          scale * 4);
+    }
+}
+
+void header(
+  std::vector<std::byte> &output,
+  const varbor::MajorType type,
+  const std::uint64_t count) {
+    varbor::write_header(std::back_inserter(output), type, count);
+}
+
+int main(const int argc, const char *const argv[]) {
+    timing = argc > 1 && std::string_view(argv[1]) == "--timing";
+
+    // Long chains of tiny indefinite-length chunks
+    check("byte string chunks", [](const std::size_t size) {
+        std::vector<std::byte> output{std::byte(2 << 5) | std::byte(31)};
+        for (std::size_t i = 0; i < size; ++i) {
+            header(output, varbor::MajorType::ByteString, 1);
+            output.push_back(std::byte(i));
+        }
+        output.push_back(std::byte(0xff));
+        return output;
+    });
+    check("text string chunks", [](const std::size_t size) {
+        std::vector<std::byte> output{std::byte(3 << 5) | std::byte(31)};
+        for (std::size_t i = 0; i < size; ++i) {
+            header(output, varbor::MajorType::Utf8String, 1);
+            output.push_back(std::byte('a'));
+        }
+        output.push_back(std::byte(0xff));
+        return output;
+    });
+
+    // Maps of near-equal keys, which are slow to compare
+    check("float keys", [](const std::size_t size) {
+        std::vector<std::byte> output;
+        header(output, varbor::MajorType::Map, size);
+        auto key = 1.0;
+        for (std::size_t i = 0; i < size; ++i) {
+            varbor::Value(key).encode(std::back_inserter(output));
+            output.push_back(std::byte(0));
+            key = std::nextafter(key, 2.0);
+        }
+        return output;
+    });
+    check("shared prefix keys", [](const std::size_t size) {
+        std::vector<std::byte> output;
+        header(output, varbor::MajorType::Map, size);
+        for (std::size_t i = 0; i < size; ++i) {
+            std::u8string key(64, u8'k');
+            key += static_cast<char8_t>('a' + i % 26);
+            key += static_cast<char8_t>('a' + i / 26 % 26);
+            key += static_cast<char8_t>('a' + i / 676);
+            varbor::Value(std::move(key)).encode(std::back_inserter(output));
+            output.push_back(std::byte(0));
+        }
+        return output;
+    });
+    check("duplicate keys", [](const std::size_t size) {
+        std::vector<std::byte> output{std::byte(5 << 5) | std::byte(31)};
+        for (std::size_t i = 0; i < size; ++i) {
+            output.push_back(std::byte(0));
+            output.push_back(std::byte(0));
+        }
+        output.push_back(std::byte(0xff));
+        return output;
+    });
+
+    // Deep nesting, kept shallow enough for the default stack
+    check("nesting", [](const std::size_t size) {
+        std::vector<std::byte> output(size / 8, std::byte(4 << 5) | std::byte(1));
+        output.push_back(std::byte(0));
+        return output;
+    });
+
+    // Huge declared counts cannot allocate ahead of the data
+    for (const auto type : {varbor::MajorType::Array, varbor::MajorType::Map}) {
+        std::vector<std::byte> input;
+        header(input, type, std::numeric_limits<std::uint32_t>::max());
+        input.push_back(std::byte(0));
+
+        varbor::Instrumented::take();
+        try {
+            varbor::Value::decode<Counted>(input);
+            throw std::runtime_error("huge count decoded");
+        } catch (const varbor::EndOfInput &) {
+        }
+        if (varbor::Instrumented::take().allocated_bytes > 1024) {
+            throw std::runtime_error("huge count allocated from contiguous input");
+        }
+
+        // Without a length to check against, the reservation is capped
+        const std::list<std::byte> list(input.begin(), input.end());
+        varbor::Instrumented::take();
+        try {
+            varbor::Value::decode<Counted>(list.begin(), list.end());
+            throw std::runtime_error("huge count decoded");
+        } catch (const varbor::EndOfInput &) {
+        }
+        if (varbor::Instrumented::take().allocated_bytes > 4096 * 2 * sizeof(varbor::Value)) {
+            throw std::runtime_error("huge count allocated from list input");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+
+#include <varbor.hxx>
+#include <varbor/concurrent.hxx>
+
+#include <thread>
+
+int main() {
+    constexpr int threads = 4;
+    constexpr int keys = 200;
+
+    // Writers on disjoint keys, all bumping one shared counter
+    varbor::ConcurrentMap map(8);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&map, t] {
+            for (int i = t; i < keys; i += threads) {
+                map.set(varbor::Value(i), varbor::Value(i * 2));
+                map.update(varbor::Value(u8"count"), [](varbor::Value &value) {
+                    if (const auto count = std::get_if<varbor::Positive>(&value.value())) {
+                        ++count->value;
+                    } else {
+                        value = varbor::Value(1);
+                    }
+                });
+            }
+        });
+    }
+    // Snapshots taken mid-write must still be canonical maps
+    workers.emplace_back([&map] {
+        for (int i = 0; i < 50; ++i) {
+            const auto encoded = map.encode();
+            const auto decoded = varbor::Value::decode(encoded);
+            if (decoded.encode() != encoded) {
+                throw std::runtime_error("snapshot not canonical");
+            }
+        }
+    });
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    varbor::Map expected;
+    for (int i = 0; i < keys; ++i) {
+        expected.value.emplace(
+          std::make_unique<varbor::Value>(i),
+          std::make_unique<varbor::Value>(i * 2));
+    }
+    expected.value.emplace(
+      std::make_unique<varbor::Value>(u8"count"),
+      std::make_unique<varbor::Value>(keys));
+    if (map.size() != keys + 1) {
+        throw std::runtime_error("size");
+    }
+    if (map.encode() != varbor::Value(std::move(expected)).encode()) {
+        throw std::runtime_error("encoding");
+    }
+
+    // Reads and erasure
+    bool read = map.read(varbor::Value(7), [](const varbor::Value &value) {
+        if (value != varbor::Value(14)) {
+            throw std::runtime_error("read value");
+        }
+    });
+    if (!read || map.read(varbor::Value(keys), [](const varbor::Value &) {})) {
+        throw std::runtime_error("read");
+    }
+    if (!map.erase(varbor::Value(7)) || map.erase(varbor::Value(7))) {
+        throw std::runtime_error("erase");
+    }
+    if (map.read(varbor::Value(7), [](const varbor::Value &) {}) || map.size() != keys) {
+        throw std::runtime_error("erased");
+    }
+
+    // Updates racing erasure of the same key
+    varbor::ConcurrentMap contested(1);
+    std::vector<std::thread> racers;
+    for (int t = 0; t < threads; ++t) {
+        racers.emplace_back([&contested] {
+            for (int i = 0; i < 2000; ++i) {
+                contested.update(varbor::Value(u8"k"), [](varbor::Value &value) {
+                    if (const auto count = std::get_if<varbor::Positive>(&value.value())) {
+                        ++count->value;
+                    } else {
+                        value = varbor::Value(1);
+                    }
+                });
+            }
+        });
+    }
+    racers.emplace_back([&contested] {
+        for (int i = 0; i < 2000; ++i) {
+            contested.erase(varbor::Value(u8"k"));
+        }
+    });
+    for (auto &racer : racers) {
+        racer.join();
+    }
+    if (contested.size() > 1) {
+        throw std::runtime_error("contested size");
+    }
+
+    // Built from a Map, encodes exactly as that Map
+    varbor::Map source;
+    source.value.emplace(
+      std::make_unique<varbor::Value>(u8"b"),
+      std::make_unique<varbor::Value>(2));
+    source.value.emplace(
+      std::make_unique<varbor::Value>(u8"a"),
+      std::make_unique<varbor::Value>(1));
+    source.value.emplace(
+      std::make_unique<varbor::Value>(-3),
+      std::make_unique<varbor::Value>(true));
+    const auto source_encoded = varbor::Value(std::move(source)).encode();
+    varbor::ConcurrentMap built(std::get<varbor::Map>(std::move(
+      varbor::Value::decode(source_encoded).value())));
+    if (built.encode() != source_encoded || varbor::ConcurrentMap().encode().size() != 1) {
+        throw std::runtime_error("from map");
+    }
+
+    // Equal keys share an entry, even when they encode differently
+    varbor::ConcurrentMap zeros(64);
+    zeros.set(varbor::Value(0.0), varbor::Value(1));
+    zeros.set(varbor::Value(-0.0), varbor::Value(2));
+    varbor::Map zeros_map;
+    zeros_map.try_emplace(0.0, 2);
+    if (zeros.size() != 1 || zeros.encode() != varbor::Value(std::move(zeros_map)).encode()) {
+        throw std::runtime_error("signed zero keys");
+    }
+    return 0;
+}
@@ -0,0 +1,117 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+
+#include <varbor.hxx>
+
+struct Strict : varbor::DecodePolicy {
+    static constexpr bool validate_utf8 = true;
+    static constexpr bool allow_indefinite = false;
+    static constexpr bool allow_floats = false;
+    static constexpr bool allow_tags = false;
+    static constexpr std::size_t max_depth = 2;
+};
+
+struct Borrowing : varbor::DecodePolicy {
+    static constexpr bool borrow_strings = true;
+};
+
+template <typename Policy>
+bool rejects(const std::vector<std::byte> &input) {
+    try {
+        varbor::Value::decode<Policy>(input);
+    } catch (const varbor::PolicyError &) {
+        return true;
+    } catch (const varbor::InvalidUtf8 &) {
+        return true;
+    }
+    return false;
+}
+
+int main() {
+    // [[1]] is within the depth limit, [[[1]]] is not
+    const std::vector<std::byte> shallow{
+      std::byte(4 << 5) | std::byte(1),
+      std::byte(4 << 5) | std::byte(1),
+      std::byte(1),
+    };
+    const std::vector<std::byte> deep{
+      std::byte(4 << 5) | std::byte(1),
+      std::byte(4 << 5) | std::byte(1),
+      std::byte(4 << 5) | std::byte(1),
+      std::byte(1),
+    };
+    if (rejects<Strict>(shallow) || !rejects<Strict>(deep)) {
+        throw std::runtime_error("max depth");
+    }
+    if (rejects<varbor::DecodePolicy>(deep)) {
+        throw std::runtime_error("default depth");
+    }
+
+    const std::vector<std::byte> indefinite{
+      std::byte(4 << 5) | std::byte(31),
+      std::byte(1),
+      std::byte(0xff),
+    };
+    if (!rejects<Strict>(indefinite) || rejects<varbor::DecodePolicy>(indefinite)) {
+        throw std::runtime_error("indefinite");
+    }
+
+    const auto number = varbor::Value(1.5).encode();
+    if (!rejects<Strict>(number) || rejects<varbor::DecodePolicy>(number)) {
+        throw std::runtime_error("floats");
+    }
+    // Simple values are not floats
+    if (rejects<Strict>(varbor::Value(true).encode())) {
+        throw std::runtime_error("boolean");
+    }
+
+    const auto tagged =
+      varbor::Value(varbor::SemanticTag(1, std::make_unique<varbor::Value>(0))).encode();
+    if (!rejects<Strict>(tagged) || rejects<varbor::DecodePolicy>(tagged)) {
+        throw std::runtime_error("tags");
+    }
+
+    // Valid multi-byte text passes, a surrogate and an overlong form do not
+    const auto text = varbor::Value(u8"größe €").encode();
+    if (rejects<Strict>(text)) {
+        throw std::runtime_error("valid utf8");
+    }
+    const std::vector<std::byte> surrogate{
+      std::byte(3 << 5) | std::byte(3),
+      std::byte(0xed),
+      std::byte(0xa0),
+      std::byte(0x80),
+    };
+    const std::vector<std::byte> overlong{
+      std::byte(3 << 5) | std::byte(2),
+      std::byte(0xc0),
+      std::byte(0xaf),
+    };
+    if (!rejects<Strict>(surrogate) || !rejects<Strict>(overlong)) {
+        throw std::runtime_error("invalid utf8");
+    }
+    if (rejects<varbor::DecodePolicy>(surrogate)) {
+        throw std::runtime_error("default utf8");
+    }
+
+    // Borrowed strings point into the input
+    varbor::Array array;
+    array.value.push_back(std::make_unique<varbor::Value>(u8"text"));
+    array.value.push_back(std::make_unique<varbor::Value>(std::vector<std::byte>{std::byte(9)}));
+    const auto encoded = varbor::Value(std::move(array)).encode();
+    const auto borrowed = varbor::Value::decode<Borrowing>(encoded);
+    const auto &items = std::get<varbor::Array>(borrowed.value()).value;
+    const std::u8string_view string = std::get<varbor::Utf8String>(items[0]->value());
+    const std::span<const std::byte> bytes = std::get<varbor::ByteString>(items[1]->value());
+    if (reinterpret_cast<const std::byte *>(string.data()) != encoded.data() + 2) {
+        throw std::runtime_error("borrowed text");
+    }
+    if (bytes.data() != encoded.data() + 7) {
+        throw std::runtime_error("borrowed bytes");
+    }
+    if (borrowed != varbor::Value::decode(encoded)) {
+        throw std::runtime_error("borrowed equality");
+    }
+    return 0;
+}
@@ -50,5 +50,10 @@ int main() {
                                    .value())
         .value)
         throw std::runtime_error("8 byte positive int");
+    try {
+        varbor::Value::decode(std::vector<std::byte>{std::byte(31)});
+        throw std::runtime_error("indefinite positive int accepted");
+    } catch (const varbor::SpecialCountError &) {
+    }
     return 0;
 }
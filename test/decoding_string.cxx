@@ -15,6 +15,17 @@ int main() {
                                                            std::byte('7')})
                                      .value()))
         throw std::runtime_error("Fail");
+
+    // An indefinite text string chunk of another type is an error, not a
+    // bad variant access
+    try {
+        varbor::Value::decode(std::vector<std::byte>{
+          std::byte(3 << 5) | std::byte(31),
+          std::byte(0),
+          std::byte(0xff)});
+        throw std::runtime_error("Wrong chunk type accepted");
+    } catch (const varbor::InvalidType &) {
+    }
     return 0;
 }
 
@@ -0,0 +1,91 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+
+#include <varbor.hxx>
+
+template <varbor::DuplicateKeys Keys, bool Ordered = false, bool SmallInts = false>
+struct Policy : varbor::DecodePolicy {
+    static constexpr varbor::DuplicateKeys duplicate_keys = Keys;
+    static constexpr bool preserve_map_order = Ordered;
+    static constexpr bool small_int_maps = SmallInts;
+};
+
+// A map of size + 1 entries where key i maps to i, then key 3 again maps to 100.
+std::vector<std::byte> input(const int size) {
+    varbor::OrderedMap map;
+    for (int i = 0; i < size; ++i) {
+        map.value.emplace_back(
+          std::make_unique<varbor::Value>(i),
+          std::make_unique<varbor::Value>(i));
+    }
+    map.value.emplace_back(
+      std::make_unique<varbor::Value>(3),
+      std::make_unique<varbor::Value>(100));
+    return varbor::Value(std::move(map)).encode();
+}
+
+template <typename P>
+bool rejects(const std::vector<std::byte> &bytes) {
+    try {
+        varbor::Value::decode<P>(bytes);
+    } catch (const varbor::DuplicateKey &) {
+        return true;
+    }
+    return false;
+}
+
+int main() {
+    using varbor::DuplicateKeys;
+
+    // Both below and above the hashed index threshold
+    for (const int size : {5, 40}) {
+        const auto bytes = input(size);
+
+        const auto first = varbor::Value::decode<Policy<DuplicateKeys::KeepFirst>>(bytes);
+        const auto &first_map = std::get<varbor::Map>(first.value()).value;
+        if (first_map.size() != static_cast<std::size_t>(size) ||
+            *first_map.find(varbor::Value(3))->second != varbor::Value(3)) {
+            throw std::runtime_error("map keep first");
+        }
+        const auto last = varbor::Value::decode<Policy<DuplicateKeys::KeepLast>>(bytes);
+        if (*std::get<varbor::Map>(last.value()).value.find(varbor::Value(3))->second !=
+            varbor::Value(100)) {
+            throw std::runtime_error("map keep last");
+        }
+        if (!rejects<Policy<DuplicateKeys::Reject>>(bytes) ||
+            rejects<Policy<DuplicateKeys::Unchecked>>(bytes)) {
+            throw std::runtime_error("map reject");
+        }
+
+        // Wire order keeps every entry unless checking is asked for
+        const auto all = varbor::Value::decode<Policy<DuplicateKeys::Unchecked, true>>(bytes);
+        if (std::get<varbor::OrderedMap>(all.value()).value.size() !=
+            static_cast<std::size_t>(size + 1)) {
+            throw std::runtime_error("ordered unchecked");
+        }
+        const auto ordered = varbor::Value::decode<Policy<DuplicateKeys::KeepLast, true>>(bytes);
+        const auto &ordered_map = std::get<varbor::OrderedMap>(ordered.value());
+        if (ordered_map.value.size() != static_cast<std::size_t>(size) ||
+            *ordered_map.value[3].second != varbor::Value(100) ||
+            !ordered_map.duplicates().empty()) {
+            throw std::runtime_error("ordered keep last");
+        }
+        if (!rejects<Policy<DuplicateKeys::Reject, true>>(bytes)) {
+            throw std::runtime_error("ordered reject");
+        }
+
+        // Small integer maps share the same check
+        const auto ints =
+          varbor::Value::decode<Policy<DuplicateKeys::KeepLast, false, true>>(bytes);
+        const auto &int_map = std::get<varbor::IntMap>(ints.value());
+        if (int_map.size() != static_cast<std::size_t>(size) ||
+            *int_map.find(3) != varbor::Value(100)) {
+            throw std::runtime_error("int map keep last");
+        }
+        if (!rejects<Policy<DuplicateKeys::Reject, false, true>>(bytes)) {
+            throw std::runtime_error("int map reject");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,82 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+
+#include <varbor.hxx>
+
+struct Borrowing : varbor::DecodePolicy {
+    static constexpr bool borrow_embedded_cbor = true;
+};
+
+int main() {
+    const std::vector<std::byte> input{
+      // Header
+      std::byte(5 << 5) | std::byte(1),
+      // String
+      std::byte(3 << 5) | std::byte(1),
+      std::byte('p'),
+      // Tag 24
+      std::byte(6 << 5) | std::byte(24),
+      std::byte(24),
+      // Byte string
+      std::byte(2 << 5) | std::byte(7),
+      // Inner array
+      std::byte(4 << 5) | std::byte(2),
+      std::byte(1),
+      // Inner tag 24, doubly embedded
+      std::byte(6 << 5) | std::byte(24),
+      std::byte(24),
+      std::byte(2 << 5) | std::byte(2),
+      std::byte(0x18),
+      std::byte(0x64),
+    };
+
+    const auto envelope = varbor::Value::decode<Borrowing>(input);
+    const auto &map = std::get<varbor::Map>(envelope.value()).value;
+    const auto &payload =
+      std::get<varbor::EmbeddedCbor>(map.at(std::make_unique<varbor::Value>(u8"p"))->value());
+    const std::span<const std::byte> bytes = payload.bytes;
+    if (!payload.borrowed() || bytes.data() != input.data() + 6 || bytes.size() != 7) {
+        throw std::runtime_error("payload not borrowed");
+    }
+
+    // Forwarding copies the inner bytes untouched
+    if (envelope.encode() != input) {
+        throw std::runtime_error("forwarding");
+    }
+
+    // Nested decoding borrows from the same buffer
+    const auto inner = payload.decode_nested<Borrowing>();
+    const auto &array = std::get<varbor::Array>(inner.value()).value;
+    if (*array[0] != varbor::Value(1)) {
+        throw std::runtime_error("nested decode");
+    }
+    const auto &nested = std::get<varbor::EmbeddedCbor>(array[1]->value());
+    const std::span<const std::byte> nested_bytes = nested.bytes;
+    if (!nested.borrowed() || nested_bytes.data() != input.data() + 11) {
+        throw std::runtime_error("nested payload not borrowed");
+    }
+    if (nested.decode_nested() != varbor::Value(100)) {
+        throw std::runtime_error("doubly nested decode");
+    }
+
+    // Detaching from the input
+    auto owned = varbor::EmbeddedCbor{payload.bytes};
+    owned.own();
+    if (owned.borrowed() || owned != payload) {
+        throw std::runtime_error("own");
+    }
+
+    // Wrapping
+    if (varbor::Value(varbor::EmbeddedCbor::wrap(varbor::Value(100))).encode() !=
+        std::vector<std::byte>{
+          std::byte(6 << 5) | std::byte(24),
+          std::byte(24),
+          std::byte(2 << 5) | std::byte(2),
+          std::byte(0x18),
+          std::byte(0x64),
+        }) {
+        throw std::runtime_error("wrap");
+    }
+    return 0;
+}
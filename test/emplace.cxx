@@ -0,0 +1,71 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+
+#include <varbor.hxx>
+
+int main() {
+    // The long way
+    varbor::Array items;
+    items.value.push_back(std::make_unique<varbor::Value>(1));
+    items.value.push_back(std::make_unique<varbor::Value>(u8"two"));
+    varbor::Array inner;
+    inner.value.push_back(std::make_unique<varbor::Value>(true));
+    items.value.push_back(std::make_unique<varbor::Value>(std::move(inner)));
+    std::vector<std::byte> items_encoded;
+    items.encode(std::back_inserter(items_encoded));
+    varbor::Map expected;
+    expected.value.emplace(
+      std::make_unique<varbor::Value>(u8"items"),
+      std::make_unique<varbor::Value>(std::move(items)));
+    expected.value.emplace(
+      std::make_unique<varbor::Value>(-1),
+      std::make_unique<varbor::Value>(varbor::Null{}));
+    const auto expected_encoded = varbor::Value(std::move(expected)).encode();
+
+    // The same document built in place
+    varbor::Map built;
+    auto &array = std::get<varbor::Array>(built.try_emplace(u8"items", varbor::Array())
+                                            .first->second->value());
+    array.emplace_back(1);
+    array.emplace_back(u8"two");
+    std::get<varbor::Array>(array.emplace_back(varbor::Array()).value()).emplace_back(true);
+    built.try_emplace(-1, varbor::Null{});
+    if (varbor::Value(std::move(built)).encode() != expected_encoded) {
+        throw std::runtime_error("emplaced document");
+    }
+
+    // Array::of reserves once and converts each argument
+    auto of = varbor::Array::of(1, u8"two", varbor::Array::of(true));
+    if (of.value.capacity() != 3 || varbor::Value(std::move(of)).encode() != items_encoded) {
+        throw std::runtime_error("Array::of");
+    }
+
+    // try_emplace leaves its arguments alone when the key exists
+    varbor::Map map;
+    std::vector<std::byte> bytes(4, std::byte(1));
+    const auto [first, added] = map.try_emplace(3, std::move(bytes));
+    std::vector<std::byte> more(4, std::byte(2));
+    const auto [second, again] = map.try_emplace(3, std::move(more));
+    if (!added || again || first != second || more.size() != 4) {
+        throw std::runtime_error("try_emplace existing");
+    }
+
+    // Out of order keys still land in place
+    map.try_emplace(1, 10);
+    map.try_emplace(2, 20);
+    map.try_emplace(4, 40);
+    std::int64_t previous = 0;
+    for (const auto &[key, value] : map.value) {
+        const auto current =
+          static_cast<std::int64_t>(std::get<varbor::Positive>(key->value()).value);
+        if (current <= previous) {
+            throw std::runtime_error("try_emplace order");
+        }
+        previous = current;
+    }
+    if (map.value.size() != 4) {
+        throw std::runtime_error("try_emplace size");
+    }
+    return 0;
+}
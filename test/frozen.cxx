@@ -0,0 +1,119 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+
+#include <varbor.hxx>
+#include <varbor/frozen.hxx>
+
+varbor::Map table(const int size) {
+    varbor::Map map;
+    for (int i = 0; i < size; ++i) {
+        std::u8string key = u8"key " + std::u8string(i % 7 + 1, u8'x');
+        key += static_cast<char8_t>(u8'a' + i % 26);
+        key += static_cast<char8_t>(u8'a' + i / 26 % 26);
+        map.value.emplace(
+          std::make_unique<varbor::Value>(std::move(key)),
+          std::make_unique<varbor::Value>(i));
+        map.value.emplace(
+          std::make_unique<varbor::Value>(-i - 1),
+          std::make_unique<varbor::Value>(i));
+    }
+    return map;
+}
+
+int main() {
+    for (const int size : {0, 1, 2, 3, 10, 100, 1000}) {
+        const auto expected = varbor::Value(table(size)).encode();
+        const auto frozen = varbor::freeze(table(size));
+        if (frozen.size() != static_cast<std::size_t>(size) * 2) {
+            throw std::runtime_error("size");
+        }
+        if (frozen.encode() != expected) {
+            throw std::runtime_error("encoding");
+        }
+
+        // Every key is found, through either kind of lookup
+        for (std::size_t i = 0; i < frozen.size(); ++i) {
+            const auto entry = frozen[i];
+            if (frozen.find_encoded(entry.key) != &entry.value) {
+                throw std::runtime_error("find encoded key");
+            }
+            if (frozen.find(varbor::Value::decode(entry.key)) != &entry.value) {
+                throw std::runtime_error("find key");
+            }
+        }
+        if (frozen.find(varbor::Value(u8"missing")) || frozen.find(varbor::Value(size))) {
+            throw std::runtime_error("find missing key");
+        }
+    }
+
+    // Entries keep Map order
+    auto frozen = varbor::freeze(table(3));
+    if (frozen.value(0) != varbor::Value(0) || varbor::Value::decode(frozen.key(0)) != -1) {
+        throw std::runtime_error("order");
+    }
+
+    // Long keys
+    varbor::Map long_keys;
+    long_keys.value.emplace(
+      std::make_unique<varbor::Value>(std::u8string(100, u8'k')),
+      std::make_unique<varbor::Value>(true));
+    const auto frozen_long = varbor::freeze(std::move(long_keys));
+    if (!frozen_long.find(varbor::Value(std::u8string(100, u8'k')))) {
+        throw std::runtime_error("long key");
+    }
+
+    // Lookups agree with the Map's key equality, not just its encodings
+    varbor::Map zeros;
+    zeros.try_emplace(0.0, 1);
+    zeros.try_emplace(varbor::Array::of(-0.0), 2);
+    const auto frozen_zeros = varbor::freeze(std::move(zeros));
+    const auto negative = frozen_zeros.find(varbor::Value(-0.0));
+    const auto positive = frozen_zeros.find(varbor::Value(varbor::Array::of(0.0)));
+    if (!negative || *negative != varbor::Value(1) || !positive || *positive != varbor::Value(2)) {
+        throw std::runtime_error("find equal key");
+    }
+    if (frozen_zeros.find_encoded(varbor::Value(-0.0).encode()) != negative ||
+        frozen_zeros.find_encoded(frozen_zeros.key(1)) != &frozen_zeros.value(1) ||
+        frozen_zeros.find(varbor::Value(1.0)) ||
+        frozen_zeros.find_encoded(varbor::Value(2.5).encode())) {
+        throw std::runtime_error("find encoded equal key");
+    }
+
+    // Keys in another layout are found as the Map would find them
+    varbor::Map inner;
+    inner.try_emplace(1, 2);
+    varbor::Map nested;
+    nested.try_emplace(varbor::Value(std::move(inner)), 1);
+    const auto frozen_nested = varbor::freeze(std::move(nested));
+    varbor::IntMap int_key;
+    int_key.insert(varbor::Value(1), varbor::Value(2));
+    if (frozen_nested.find(varbor::Value(std::move(int_key))) != &frozen_nested.value(0)) {
+        throw std::runtime_error("find key in another layout");
+    }
+
+    // Only float headers count as floats, not float-like bytes in strings
+    const std::vector<std::byte> float_bytes{std::byte(0xf9), std::byte(0xfa), std::byte(0xfb)};
+    varbor::Map strings;
+    strings.try_emplace(varbor::ByteString(float_bytes), 1);
+    strings.try_emplace(varbor::Array::of(varbor::ByteString(float_bytes), 1.5), 2);
+    const auto frozen_strings = varbor::freeze(std::move(strings));
+    if (varbor::detail::holds_float(frozen_strings.key(0)) ||
+        !varbor::detail::holds_float(frozen_strings.key(1))) {
+        throw std::runtime_error("holds float");
+    }
+    if (frozen_strings.find_encoded(frozen_strings.key(0)) != &frozen_strings.value(0) ||
+        frozen_strings.find_encoded(frozen_strings.key(1)) != &frozen_strings.value(1) ||
+        frozen_strings.find(varbor::Value(varbor::ByteString(float_bytes))) !=
+          &frozen_strings.value(0)) {
+        throw std::runtime_error("find float-like string key");
+    }
+
+    if (varbor::Value(std::move(frozen).thaw()) != varbor::Value(table(3))) {
+        throw std::runtime_error("thaw");
+    }
+    if (!frozen.empty()) {
+        throw std::runtime_error("thaw left entries behind");
+    }
+    return 0;
+}
@@ -0,0 +1,75 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+
+#include <varbor.hxx>
+#include <varbor/instrument.hxx>
+
+struct Counted : varbor::DecodePolicy {
+    using instrument = varbor::Instrumented;
+};
+
+int main() {
+    const std::vector<std::byte> input{
+      // Header
+      std::byte(5 << 5) | std::byte(2),
+      // "a": [1, h'0203']
+      std::byte(3 << 5) | std::byte(1),
+      std::byte('a'),
+      std::byte(4 << 5) | std::byte(2),
+      std::byte(1),
+      std::byte(2 << 5) | std::byte(2),
+      std::byte(2),
+      std::byte(3),
+      // "b": null
+      std::byte(3 << 5) | std::byte(1),
+      std::byte('b'),
+      std::byte(0xf6),
+    };
+
+    // Uninstrumented decodes leave the counters alone
+    varbor::Instrumented::take();
+    const auto plain = varbor::Value::decode(input);
+    if (varbor::Instrumented::statistics() != varbor::Statistics{}) {
+        throw std::runtime_error("default policy counted");
+    }
+
+    const auto decoded = varbor::Value::decode<Counted>(input);
+    if (decoded != plain) {
+        throw std::runtime_error("instrumented decode differs");
+    }
+    const auto decoding = varbor::Instrumented::take();
+    if (decoding.total_nodes() != 7 || decoding.count<varbor::Utf8String>() != 2 ||
+        decoding.count<varbor::Map>() != 1 || decoding.count<varbor::Null>() != 1) {
+        throw std::runtime_error("decoded node counts");
+    }
+    if (decoding.bytes_copied != 4) {
+        throw std::runtime_error("bytes copied");
+    }
+    if (decoding.max_depth != 2) {
+        throw std::runtime_error("decode depth");
+    }
+    // Array storage plus two Values, and two keys and values
+    if (decoding.allocations < 7 || decoding.allocated_bytes < 6 * sizeof(varbor::Value)) {
+        throw std::runtime_error("allocations");
+    }
+    if (decoding.map_comparisons == 0) {
+        throw std::runtime_error("map comparisons");
+    }
+    if (varbor::Instrumented::statistics() != varbor::Statistics{}) {
+        throw std::runtime_error("take did not reset");
+    }
+
+    std::vector<std::byte> output;
+    const auto written =
+      decoded.encode(varbor::Instrumented::Output(std::back_inserter(output))).base();
+    static_cast<void>(written);
+    const auto encoding = varbor::Instrumented::take();
+    if (output != input || encoding.bytes_written != input.size()) {
+        throw std::runtime_error("encode bytes");
+    }
+    if (encoding.nodes != decoding.nodes || encoding.max_depth != 2) {
+        throw std::runtime_error("encode nodes");
+    }
+    return 0;
+}
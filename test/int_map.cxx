@@ -0,0 +1,144 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+
+#include <varbor.hxx>
+
+struct SmallInts : varbor::DecodePolicy {
+    static constexpr bool small_int_maps = true;
+};
+
+int main() {
+    // A COSE-style header map, with keys out of canonical order
+    const std::vector<std::byte> input{
+      // Header
+      std::byte(5 << 5) | std::byte(5),
+      // -1: 1
+      std::byte(1 << 5) | std::byte(0),
+      std::byte(1),
+      // 4: h'aa'
+      std::byte(4),
+      std::byte(2 << 5) | std::byte(1),
+      std::byte(0xaa),
+      // "k": 0
+      std::byte(3 << 5) | std::byte(1),
+      std::byte('k'),
+      std::byte(0),
+      // 33: 2
+      std::byte(24),
+      std::byte(33),
+      std::byte(2),
+      // 1: -7
+      std::byte(1),
+      std::byte(1 << 5) | std::byte(6),
+    };
+
+    const auto decoded = varbor::Value::decode<SmallInts>(input);
+    const auto &map = std::get<varbor::IntMap>(decoded.value());
+    if (map.size() != 5 || map.rest.value.size() != 2) {
+        throw std::runtime_error("int map layout");
+    }
+    if (*map.find(1) != varbor::Value(-7)) {
+        throw std::runtime_error("find 1");
+    }
+    if (*map.find(-1) != varbor::Value(1)) {
+        throw std::runtime_error("find -1");
+    }
+    if (*map.find(33) != varbor::Value(2)) {
+        throw std::runtime_error("find 33");
+    }
+    if (*map.find(varbor::Value(u8"k")) != varbor::Value(0)) {
+        throw std::runtime_error("find k");
+    }
+    if (map.find(5) != nullptr || map.find(-24) != nullptr || map.find(1000) != nullptr) {
+        throw std::runtime_error("find missing");
+    }
+
+    // Encodes exactly like the equivalent Map
+    const auto canonical = varbor::Value::decode(input).encode();
+    if (decoded.encode() != canonical) {
+        throw std::runtime_error("int map encoding");
+    }
+    if (decoded != varbor::Value::decode<SmallInts>(canonical)) {
+        throw std::runtime_error("int map equality");
+    }
+
+    varbor::IntMap smaller;
+    smaller.insert(varbor::Value(1), varbor::Value(6));
+    varbor::IntMap larger;
+    larger.insert(varbor::Value(1), varbor::Value(7));
+    if (!(smaller < larger) || smaller == larger) {
+        throw std::runtime_error("int map ordering");
+    }
+    // Entries are compared in encoding order, across slots and other keys
+    const auto mixed = [](const std::int64_t small, const std::int64_t other) {
+        varbor::IntMap map;
+        map.insert(varbor::Value(-1), varbor::Value(0));
+        map.insert(varbor::Value(small), varbor::Value(0));
+        map.insert(varbor::Value(other), varbor::Value(0));
+        map.insert(varbor::Value(u8"key"), varbor::Value(0));
+        return map;
+    };
+    if ((mixed(2, 200) <=> mixed(2, 200)) != std::strong_ordering::equal) {
+        throw std::runtime_error("mixed int map equal ordering");
+    }
+    if (!(mixed(2, 200) < mixed(2, 201)) || !(mixed(3, 200) > mixed(2, 201))) {
+        throw std::runtime_error("mixed int map ordering");
+    }
+    if (smaller.insert(varbor::Value(1), varbor::Value(0))) {
+        throw std::runtime_error("duplicate insert");
+    }
+
+    // Equal to and ordered as the Map it stands for
+    if (decoded != varbor::Value::decode(input) || (decoded <=> varbor::Value::decode(input)) != 0) {
+        throw std::runtime_error("int map equals map");
+    }
+    const std::vector<std::byte> one{
+      std::byte(5 << 5) | std::byte(1),
+      std::byte(1),
+      std::byte(2),
+    };
+    const auto small = varbor::Value::decode<SmallInts>(one);
+    if (!std::holds_alternative<varbor::IntMap>(small.value()) || small != varbor::Value::decode(one)) {
+        throw std::runtime_error("small int map equals map");
+    }
+    if (!(small < varbor::Value(varbor::Boolean(false))) || !(small > varbor::Value(varbor::Array{}))) {
+        throw std::runtime_error("int map sorts as a map");
+    }
+
+    // Map keys in either layout are the same key, and sort by their encoding
+    varbor::Map keyed;
+    keyed.try_emplace(varbor::Value::decode<SmallInts>(one), varbor::Value(0));
+    if (keyed.try_emplace(varbor::Value::decode(one), varbor::Value(1)).second) {
+        throw std::runtime_error("duplicate mixed layout key");
+    }
+    const std::vector<std::byte> mixed_keys{
+      std::byte(5 << 5) | std::byte(2),
+      // {0: 0}: 1
+      std::byte(5 << 5) | std::byte(1),
+      std::byte(0),
+      std::byte(0),
+      std::byte(1),
+      // false: 2
+      std::byte(7 << 5) | std::byte(20),
+      std::byte(2),
+    };
+    if (varbor::Value::decode<SmallInts>(mixed_keys).encode() != mixed_keys) {
+        throw std::runtime_error("mixed layout key order");
+    }
+
+    // Mostly non-integer keys stay a Map
+    const std::vector<std::byte> text{
+      std::byte(5 << 5) | std::byte(2),
+      std::byte(3 << 5) | std::byte(1),
+      std::byte('a'),
+      std::byte(0),
+      std::byte(3 << 5) | std::byte(1),
+      std::byte('b'),
+      std::byte(0),
+    };
+    if (!std::holds_alternative<varbor::Map>(varbor::Value::decode<SmallInts>(text).value())) {
+        throw std::runtime_error("text keys");
+    }
+    return 0;
+}
@@ -0,0 +1,65 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+
+#include <varbor.hxx>
+#include <varbor/io.hxx>
+
+#include <sstream>
+
+int main() {
+    varbor::Map map;
+    map.value.emplace(
+      std::make_unique<varbor::Value>(u8"text"),
+      std::make_unique<varbor::Value>(u8"a string long enough to span several buffers"));
+    map.value.emplace(
+      std::make_unique<varbor::Value>(u8"bytes"),
+      std::make_unique<varbor::Value>(std::vector<std::byte>(100, std::byte(3))));
+    map.value.emplace(
+      std::make_unique<varbor::Value>(7),
+      std::make_unique<varbor::Value>(-2.5));
+    const varbor::Value value(std::move(map));
+    const auto expected = value.encode();
+
+    // Sinks produce the same bytes as encoding directly
+    std::vector<std::byte> vector;
+    varbor::VectorSink vector_sink(vector);
+    varbor::encode(value, vector_sink);
+    if (vector != expected) {
+        throw std::runtime_error("vector sink");
+    }
+
+    // Two items back to back through a tiny buffer
+    std::stringstream stream;
+    {
+        varbor::StreamSink stream_sink(stream, 3);
+        varbor::encode(value, stream_sink);
+        varbor::encode(varbor::Value(42), stream_sink);
+    }
+
+    varbor::StreamSource stream_source(stream, 5);
+    if (varbor::decode(stream_source) != value) {
+        throw std::runtime_error("stream source first item");
+    }
+    if (varbor::decode(stream_source) != 42) {
+        throw std::runtime_error("stream source second item");
+    }
+    if (!stream_source.buffered().empty()) {
+        throw std::runtime_error("stream source not at end");
+    }
+
+    varbor::SpanSource span_source(expected);
+    if (varbor::decode(span_source) != value) {
+        throw std::runtime_error("span source");
+    }
+
+    // Truncated input
+    const std::span<const std::byte> truncated(expected.data(), expected.size() - 10);
+    varbor::SpanSource truncated_source(truncated);
+    try {
+        varbor::decode(truncated_source);
+        throw std::runtime_error("truncated input decoded");
+    } catch (const varbor::EndOfInput &) {
+    }
+    return 0;
+}
@@ -0,0 +1,27 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+import varbor;
+
+int main() {
+    varbor::Map map;
+    map.try_emplace(u8"key", varbor::Array::of(1, u8"two", 3.5));
+    const varbor::Value value(std::move(map));
+
+    const auto encoded = value.encode();
+    const auto decoded = varbor::Value::decode(encoded);
+    if (decoded != value || decoded[u8"key"][1] != varbor::Value(u8"two")) {
+        throw std::runtime_error("round trip through the module");
+    }
+
+    // The std::hash specialization is reachable without being re-exported
+    if (std::hash<varbor::Value>{}(decoded) != static_cast<std::size_t>(value.hash())) {
+        throw std::runtime_error("hash");
+    }
+    return 0;
+}
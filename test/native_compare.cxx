@@ -0,0 +1,98 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+
+#include <varbor.hxx>
+
+#include <cstdlib>
+#include <new>
+
+static std::size_t allocations = 0;
+
+void *operator new(const std::size_t size) {
+    ++allocations;
+    if (const auto pointer = std::malloc(size)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *const pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void *const pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+// Comparing with native must agree with comparing with Value(native).
+template <typename T>
+void check(const varbor::Value &value, const T &native) {
+    const varbor::Value converted(native);
+    if ((value == native) != (value == converted)) {
+        throw std::runtime_error("equality disagrees");
+    }
+    if ((value <=> native) != (value <=> converted)) {
+        throw std::runtime_error("ordering disagrees");
+    }
+}
+
+int main() {
+    std::vector<varbor::Value> values;
+    values.emplace_back(0);
+    values.emplace_back(42);
+    values.emplace_back(-1);
+    values.emplace_back(-7);
+    values.emplace_back(std::numeric_limits<std::int64_t>::min());
+    values.emplace_back(std::numeric_limits<std::uint64_t>::max());
+    values.emplace_back(1.5);
+    values.emplace_back(100000.25);
+    values.emplace_back(std::numeric_limits<double>::quiet_NaN());
+    values.emplace_back(true);
+    values.emplace_back(nullptr);
+    values.emplace_back(u8"ok");
+    values.emplace_back(u8"other");
+    values.emplace_back(std::vector<std::byte>{std::byte(1), std::byte(2)});
+    values.emplace_back(varbor::Break{});
+
+    const std::vector<std::byte> bytes{std::byte(1), std::byte(2)};
+    for (const auto &value : values) {
+        check(value, 0);
+        check(value, 42);
+        check(value, 42u);
+        check(value, std::int8_t(-1));
+        check(value, -6);
+        check(value, -7l);
+        check(value, std::numeric_limits<std::int64_t>::min());
+        check(value, std::numeric_limits<std::uint64_t>::max());
+        check(value, 1.5);
+        check(value, 1.5f);
+        check(value, 100000.25);
+        check(value, std::numeric_limits<double>::quiet_NaN());
+        check(value, true);
+        check(value, false);
+        check(value, nullptr);
+        check(value, u8"ok");
+        check(value, std::u8string_view(u8"other"));
+        check(value, std::span<const std::byte>(bytes));
+        if ((value == varbor::Break{}) != (value == varbor::Value(varbor::Break{}))) {
+            throw std::runtime_error("alternative equality");
+        }
+    }
+
+    // Reversed operands are synthesized
+    if (!(42 == values[1]) || !(u8"ok" == values[11]) || !(41 < values[1])) {
+        throw std::runtime_error("reversed");
+    }
+
+    // Comparisons allocate nothing
+    const varbor::Value text(u8"a somewhat longer string that will not fit in SSO");
+    allocations = 0;
+    const bool equal = text == u8"a somewhat longer string that will not fit in SSO" &&
+      values[1] == 42 && values[3] == -7 && values[6] == 1.5 && values[10] == nullptr &&
+      std::is_gt(text <=> u8"short");
+    if (!equal || allocations != 0) {
+        throw std::runtime_error("native comparison allocated");
+    }
+    return 0;
+}
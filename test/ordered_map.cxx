@@ -0,0 +1,178 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+
+#include <varbor.hxx>
+
+struct Ordered : varbor::DecodePolicy {
+    static constexpr bool preserve_map_order = true;
+};
+
+int main() {
+    const std::vector<std::byte> input{
+      // Header
+      std::byte(5 << 5) | std::byte(3),
+      // String
+      std::byte(3 << 5) | std::byte(1),
+      std::byte('b'),
+      std::byte(1),
+      // String
+      std::byte(3 << 5) | std::byte(1),
+      std::byte('a'),
+      std::byte(2),
+      // Duplicate
+      std::byte(3 << 5) | std::byte(1),
+      std::byte('b'),
+      std::byte(3),
+    };
+
+    // The default still sorts and drops duplicates
+    const auto sorted = varbor::Value::decode(input);
+    if (std::get<varbor::Map>(sorted.value()).value.size() != 2) {
+        throw std::runtime_error("default map");
+    }
+
+    const auto ordered = varbor::Value::decode<Ordered>(input);
+    const auto &map = std::get<varbor::OrderedMap>(ordered.value());
+    if (map.value.size() != 3) {
+        throw std::runtime_error("ordered map dropped entries");
+    }
+    if (ordered.encode() != input) {
+        throw std::runtime_error("ordered map round trip");
+    }
+    if (map.duplicates() != std::vector<std::size_t>{2}) {
+        throw std::runtime_error("duplicates");
+    }
+    const auto b = map.find(varbor::Value(u8"b"));
+    if (b == map.value.end() || *b->second != varbor::Value(1)) {
+        throw std::runtime_error("find first of duplicate key");
+    }
+    if (map.find(varbor::Value(u8"c")) != map.value.end()) {
+        throw std::runtime_error("find missing key");
+    }
+
+    // Large enough for the hashed index, appended to after the first lookup
+    varbor::OrderedMap large;
+    for (int i = 0; i < 100; ++i) {
+        large.value.emplace_back(
+          std::make_unique<varbor::Value>(100 - i),
+          std::make_unique<varbor::Value>(i));
+    }
+    if (*large.find(varbor::Value(42))->second != varbor::Value(58)) {
+        throw std::runtime_error("indexed find");
+    }
+    large.value.emplace_back(
+      std::make_unique<varbor::Value>(u8"late"),
+      std::make_unique<varbor::Value>(true));
+    if (*large.find(varbor::Value(u8"late"))->second != varbor::Value(true)) {
+        throw std::runtime_error("indexed find after append");
+    }
+    *large.value.front().first = varbor::Value(-1);
+    large.reindex();
+    if (large.find(varbor::Value(-1)) != large.value.begin()) {
+        throw std::runtime_error("indexed find after reindex");
+    }
+
+    // Const lookups use the index as far as it reaches, and scan past it
+    large.value.emplace_back(
+      std::make_unique<varbor::Value>(u8"unindexed"),
+      std::make_unique<varbor::Value>(false));
+    const auto &reader = large;
+    if (*reader.find(varbor::Value(u8"unindexed"))->second != varbor::Value(false) ||
+        *reader.find(varbor::Value(42))->second != varbor::Value(58) ||
+        reader.find(varbor::Value(u8"absent")) != reader.value.end()) {
+        throw std::runtime_error("const find");
+    }
+    large.reindex();
+    if (*reader.find(varbor::Value(42))->second != varbor::Value(58)) {
+        throw std::runtime_error("const find without an index");
+    }
+
+    // Equal keys hash alike, so 0.0 finds -0.0 through the index too
+    if (varbor::Value(0.0).hash() != varbor::Value(-0.0).hash() ||
+        varbor::Value(std::numeric_limits<double>::quiet_NaN()).hash() !=
+          varbor::Value(-std::numeric_limits<double>::quiet_NaN()).hash()) {
+        throw std::runtime_error("float hash");
+    }
+    for (const std::size_t size : {4, 40}) {
+        varbor::OrderedMap zeros;
+        for (std::size_t i = 0; i < size; ++i) {
+            zeros.value.emplace_back(
+              std::make_unique<varbor::Value>(static_cast<int>(i) + 1),
+              std::make_unique<varbor::Value>(varbor::Null{}));
+        }
+        zeros.value.emplace_back(
+          std::make_unique<varbor::Value>(-0.0),
+          std::make_unique<varbor::Value>(u8"zero"));
+        zeros.value.emplace_back(
+          std::make_unique<varbor::Value>(0.0),
+          std::make_unique<varbor::Value>(u8"again"));
+        if (zeros.find(varbor::Value(0.0)) != zeros.value.end() - 2 ||
+            zeros.duplicates() != std::vector<std::size_t>{size + 1}) {
+            throw std::runtime_error("signed zero keys");
+        }
+    }
+
+    // And sort alike, so a Map keeps one of them
+    varbor::Map zeros;
+    zeros.try_emplace(0.0, 1);
+    zeros.try_emplace(-0.0, 2);
+    if (zeros.value.size() != 1) {
+        throw std::runtime_error("signed zero order");
+    }
+
+    // Nested maps also keep their order
+    const std::vector<std::byte> nested{
+      std::byte(5 << 5) | std::byte(1),
+      std::byte(9),
+      std::byte(5 << 5) | std::byte(2),
+      std::byte(3),
+      std::byte(4 << 5),
+      std::byte(1),
+      std::byte(4 << 5),
+    };
+    if (varbor::Value::decode<Ordered>(nested).encode() != nested) {
+        throw std::runtime_error("nested round trip");
+    }
+
+    // Compares as the map its encoding would be read as
+    const std::vector<std::byte> in_order{
+      std::byte(5 << 5) | std::byte(2),
+      std::byte(1),
+      std::byte(2),
+      std::byte(3),
+      std::byte(4),
+    };
+    const std::vector<std::byte> swapped{
+      std::byte(5 << 5) | std::byte(2),
+      std::byte(3),
+      std::byte(4),
+      std::byte(1),
+      std::byte(2),
+    };
+    if (varbor::Value::decode<Ordered>(in_order) != varbor::Value::decode(in_order)) {
+        throw std::runtime_error("ordered map equals map");
+    }
+    if (varbor::Value::decode<Ordered>(swapped) == varbor::Value::decode(swapped) ||
+      !(varbor::Value::decode<Ordered>(swapped) > varbor::Value::decode(swapped))) {
+        throw std::runtime_error("ordered map compares in wire order");
+    }
+
+    // So a Map keyed by OrderedMaps never holds one encoding twice, and sorts
+    // its keys by their encodings
+    varbor::Map keyed;
+    keyed.try_emplace(varbor::Value::decode<Ordered>(swapped), varbor::Value(0));
+    keyed.try_emplace(varbor::Value::decode<Ordered>(in_order), varbor::Value(1));
+    if (keyed.try_emplace(varbor::Value::decode(in_order), varbor::Value(2)).second) {
+        throw std::runtime_error("duplicate ordered map key");
+    }
+    std::vector<std::byte> expected{std::byte(5 << 5) | std::byte(2)};
+    expected.insert(expected.end(), in_order.begin(), in_order.end());
+    expected.push_back(std::byte(1));
+    expected.insert(expected.end(), swapped.begin(), swapped.end());
+    expected.push_back(std::byte(0));
+    if (varbor::Value(std::move(keyed)).encode() != expected) {
+        throw std::runtime_error("ordered map key order");
+    }
+    return 0;
+}
@@ -0,0 +1,93 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+
+#include <varbor.hxx>
+#include <varbor/parallel.hxx>
+
+#include <random>
+
+struct Bulk : varbor::ParallelDecodePolicy {
+    static constexpr std::size_t bulk_map_threshold = 8;
+};
+
+struct BulkKeepLast : Bulk {
+    static constexpr varbor::DuplicateKeys duplicate_keys = varbor::DuplicateKeys::KeepLast;
+};
+
+struct BulkReject : Bulk {
+    static constexpr varbor::DuplicateKeys duplicate_keys = varbor::DuplicateKeys::Reject;
+};
+
+struct KeepLast : varbor::DecodePolicy {
+    static constexpr varbor::DuplicateKeys duplicate_keys = varbor::DuplicateKeys::KeepLast;
+};
+
+// A map header for count entries, followed by the entries' encoded pairs.
+static std::vector<std::byte> map(const std::vector<std::pair<int, int>> &entries) {
+    std::vector<std::byte> output;
+    auto it = varbor::write_header(
+      std::back_inserter(output),
+      varbor::MajorType::Map,
+      entries.size());
+    for (const auto &[key, value] : entries) {
+        it = varbor::Value(key).encode(it);
+        it = varbor::Value(value).encode(it);
+    }
+    return output;
+}
+
+int main() {
+    std::mt19937 random(5);
+
+    // Stable across several threads, against std::stable_sort
+    std::vector<std::pair<int, int>> pairs(100000);
+    for (std::size_t i = 0; i < pairs.size(); ++i) {
+        pairs[i] = {static_cast<int>(random() % 1000), static_cast<int>(i)};
+    }
+    auto expected = pairs;
+    const auto by_first = [](const auto &a, const auto &b) {
+        return a.first < b.first;
+    };
+    std::stable_sort(expected.begin(), expected.end(), by_first);
+    for (const std::size_t threads : {1, 2, 3, 8}) {
+        auto sorted = pairs;
+        varbor::parallel_stable_sort(sorted.begin(), sorted.end(), by_first, threads, 1000);
+        if (sorted != expected) {
+            throw std::runtime_error("parallel_stable_sort");
+        }
+    }
+
+    // Bulk decoding builds the same Map as inserting, sorted or not
+    std::vector<std::pair<int, int>> entries;
+    for (int i = 0; i < 5000; ++i) {
+        entries.emplace_back(static_cast<int>(random() % 3000) - 1500, i);
+    }
+    const auto shuffled = map(entries);
+    if (varbor::Value::decode<BulkKeepLast>(shuffled) !=
+          varbor::Value::decode<KeepLast>(shuffled) ||
+        varbor::Value::decode<Bulk>(shuffled) != varbor::Value::decode(shuffled)) {
+        throw std::runtime_error("bulk decode");
+    }
+    std::ranges::stable_sort(entries, by_first);
+    const auto ordered = map(entries);
+    if (varbor::Value::decode<BulkKeepLast>(ordered) !=
+          varbor::Value::decode<KeepLast>(ordered) ||
+        varbor::Value::decode<Bulk>(ordered) != varbor::Value::decode(ordered)) {
+        throw std::runtime_error("bulk decode in order");
+    }
+
+    // Duplicates are still found once sorted
+    try {
+        varbor::Value::decode<BulkReject>(shuffled);
+        throw std::runtime_error("duplicate accepted");
+    } catch (const varbor::DuplicateKey &) {
+    }
+
+    // Maps below the threshold take the ordinary path
+    const auto small = map({{3, 0}, {1, 1}, {2, 2}});
+    if (varbor::Value::decode<Bulk>(small).encode() != map({{1, 1}, {2, 2}, {3, 0}})) {
+        throw std::runtime_error("small map");
+    }
+    return 0;
+}
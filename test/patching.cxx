@@ -0,0 +1,133 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+
+#include <varbor.hxx>
+#include <varbor/patch.hxx>
+
+int main() {
+    varbor::Map map;
+    varbor::Array list;
+    list.value.push_back(std::make_unique<varbor::Value>(1));
+    list.value.push_back(std::make_unique<varbor::Value>(2));
+    list.value.push_back(std::make_unique<varbor::Value>(3));
+    map.value.insert(std::make_pair(
+      std::make_unique<varbor::Value>(u8"counter"),
+      std::make_unique<varbor::Value>(300)));
+    map.value.insert(std::make_pair(
+      std::make_unique<varbor::Value>(u8"list"),
+      std::make_unique<varbor::Value>(std::move(list))));
+    map.value.insert(std::make_pair(
+      std::make_unique<varbor::Value>(7),
+      std::make_unique<varbor::Value>(1.5)));
+    auto buffer = varbor::Value(std::move(map)).encode();
+
+    const auto counter = varbor::locate(buffer, {u8"counter"});
+    if (!counter || counter->size != 3) {
+        throw std::runtime_error("locate counter");
+    }
+
+    // Same width
+    const auto size = buffer.size();
+    if (!varbor::patch_in_place(buffer, *counter, varbor::Value(301))) {
+        throw std::runtime_error("patch same width");
+    }
+    // Narrower values are widened to the existing header
+    if (!varbor::patch_in_place(buffer, *counter, varbor::Value(5))) {
+        throw std::runtime_error("patch widened");
+    }
+    if (buffer.size() != size) {
+        throw std::runtime_error("in place patch resized buffer");
+    }
+    const auto decoded = varbor::Value::decode(buffer);
+    const auto &decoded_map = std::get<varbor::Map>(decoded.value()).value;
+    if (*decoded_map.at(std::make_unique<varbor::Value>(u8"counter")) != varbor::Value(5)) {
+        throw std::runtime_error("widened counter");
+    }
+
+    // Too wide to fit
+    if (varbor::patch_in_place(buffer, *counter, varbor::Value(70000))) {
+        throw std::runtime_error("patch should not fit");
+    }
+    if (!varbor::patch(buffer, {u8"counter"}, varbor::Value(70000))) {
+        throw std::runtime_error("patch splice");
+    }
+    if (buffer.size() != size + 2) {
+        throw std::runtime_error("splice size");
+    }
+
+    // Nested path, replacing a scalar with a string
+    if (!varbor::patch(buffer, {u8"list", 1}, varbor::Value(u8"two"))) {
+        throw std::runtime_error("patch nested");
+    }
+    if (varbor::patch(buffer, {u8"list", 3}, varbor::Value(4))) {
+        throw std::runtime_error("patch past end of array");
+    }
+    if (varbor::locate(buffer, {u8"missing"})) {
+        throw std::runtime_error("locate missing key");
+    }
+
+    // Integer keys and floats
+    const auto number = varbor::locate(buffer, {7});
+    if (!number || !varbor::patch_in_place(buffer, *number, varbor::Value(2.5))) {
+        throw std::runtime_error("patch float");
+    }
+
+    varbor::Map expected_map;
+    varbor::Array expected_list;
+    expected_list.value.push_back(std::make_unique<varbor::Value>(1));
+    expected_list.value.push_back(std::make_unique<varbor::Value>(u8"two"));
+    expected_list.value.push_back(std::make_unique<varbor::Value>(3));
+    expected_map.value.insert(std::make_pair(
+      std::make_unique<varbor::Value>(u8"counter"),
+      std::make_unique<varbor::Value>(70000)));
+    expected_map.value.insert(std::make_pair(
+      std::make_unique<varbor::Value>(u8"list"),
+      std::make_unique<varbor::Value>(std::move(expected_list))));
+    expected_map.value.insert(std::make_pair(
+      std::make_unique<varbor::Value>(7),
+      std::make_unique<varbor::Value>(2.5)));
+
+    if (varbor::Value::decode(buffer) != varbor::Value(std::move(expected_map))) {
+        throw std::runtime_error("Fail");
+    }
+
+    // Indefinite-length containers are walked through their breaks
+    const std::vector<std::byte> indefinite{
+      // Indefinite map
+      std::byte(5 << 5) | std::byte(31),
+      std::byte(3 << 5) | std::byte(1),
+      std::byte('a'),
+      // Indefinite array
+      std::byte(4 << 5) | std::byte(31),
+      std::byte(0),
+      std::byte(0) | std::byte(24),
+      std::byte(100),
+      std::byte(0xff),
+      std::byte(0xff),
+    };
+    if (varbor::locate(indefinite, {u8"a", 1}) != varbor::Extent{5, 2}) {
+        throw std::runtime_error("locate indefinite");
+    }
+    if (varbor::locate(indefinite, {u8"a", 2})) {
+        throw std::runtime_error("locate past indefinite end");
+    }
+
+    // Skipping deeply nested items does not recurse
+    std::vector<std::byte> deep{std::byte(0xa1), std::byte(0x01)};
+    deep.insert(deep.end(), 1000000, std::byte(0x81));
+    deep.push_back(std::byte(0x00));
+    if (varbor::locate(deep, {2})) {
+        throw std::runtime_error("locate past deep value");
+    }
+    if (varbor::locate(deep, {1}) != varbor::Extent{2, deep.size() - 2}) {
+        throw std::runtime_error("locate deep value");
+    }
+    deep.pop_back();
+    try {
+        varbor::locate(deep, {2});
+        throw std::runtime_error("locate truncated deep value");
+    } catch (const varbor::EndOfInput &) {
+    }
+    return 0;
+}
@@ -0,0 +1,123 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+
+#include <varbor.hxx>
+#include <varbor/persistent.hxx>
+
+#include <random>
+
+int main() {
+    std::mt19937 random(7);
+
+    // Random updates checked against a Map, keeping every version
+    varbor::Map reference;
+    std::vector<varbor::PersistentMap> versions{varbor::PersistentMap()};
+    std::vector<std::vector<std::byte>> encodings{varbor::Value(varbor::Map()).encode()};
+    for (int i = 0; i < 2000; ++i) {
+        const int key = static_cast<int>(random() % 500);
+        if (random() % 3 == 0) {
+            if (const auto found = reference.value.find(varbor::Value(key));
+                found != reference.value.end()) {
+                reference.value.erase(found);
+            }
+            versions.push_back(versions.back().erase(varbor::Value(key)));
+        } else {
+            reference.value.insert_or_assign(
+              std::make_unique<varbor::Value>(key),
+              std::make_unique<varbor::Value>(i));
+            versions.push_back(versions.back().set(varbor::Value(key), varbor::Value(i)));
+        }
+        encodings.push_back(versions.back().encode());
+        std::vector<std::byte> expected;
+        reference.encode(std::back_inserter(expected));
+        if (encodings.back() != expected) {
+            throw std::runtime_error("map encoding");
+        }
+    }
+
+    // Old versions are untouched by later updates
+    for (std::size_t i = 0; i < versions.size(); ++i) {
+        if (versions[i].encode() != encodings[i]) {
+            throw std::runtime_error("map snapshot changed");
+        }
+    }
+
+    // Updates share everything off the changed path
+    const auto before = versions.back();
+    const auto after = before.set(varbor::Value(10000), varbor::Value(true));
+    for (const auto &[key, value] : before) {
+        if (after.find(key) != &value) {
+            throw std::runtime_error("map nodes not shared");
+        }
+    }
+    if (before.find(varbor::Value(10000)) || *after.find(varbor::Value(10000)) != true) {
+        throw std::runtime_error("map set");
+    }
+
+    // Built from a Map, encodes identically
+    varbor::Map map;
+    for (int i = 0; i < 100; ++i) {
+        map.value.emplace(
+          std::make_unique<varbor::Value>(u8"key" + std::u8string(i % 10, u8'x')),
+          std::make_unique<varbor::Value>(i));
+        map.value.emplace(
+          std::make_unique<varbor::Value>(i),
+          std::make_unique<varbor::Value>(-i));
+    }
+    const auto map_encoding = varbor::Value(std::move(map)).encode();
+    auto map_copy = varbor::Value::decode(map_encoding);
+    const varbor::PersistentMap persistent(std::move(std::get<varbor::Map>(map_copy.value())));
+    if (persistent.encode() != map_encoding) {
+        throw std::runtime_error("map built from Map");
+    }
+
+    // Arrays, across several trie levels
+    varbor::PersistentArray array;
+    std::vector<varbor::PersistentArray> array_versions;
+    for (int i = 0; i < 1100; ++i) {
+        array_versions.push_back(array);
+        array = array.push_back(varbor::Value(i));
+    }
+    for (int i = 0; i < 1100; ++i) {
+        if (array[static_cast<std::size_t>(i)] != i) {
+            throw std::runtime_error("array index");
+        }
+        if (array_versions[static_cast<std::size_t>(i)].size() != static_cast<std::size_t>(i)) {
+            throw std::runtime_error("array snapshot");
+        }
+    }
+    const auto changed = array.set(1024, varbor::Value(u8"changed"));
+    if (array[1024] != 1024 || changed[1024] != u8"changed" || &changed[0] != &array[0]) {
+        throw std::runtime_error("array set");
+    }
+
+    varbor::Array plain;
+    for (int i = 0; i < 1100; ++i) {
+        plain.value.push_back(std::make_unique<varbor::Value>(i));
+    }
+    const auto array_encoding = varbor::Value(std::move(plain)).encode();
+    if (array.encode() != array_encoding) {
+        throw std::runtime_error("array encoding");
+    }
+    auto array_copy = varbor::Value::decode(array_encoding);
+    const varbor::PersistentArray from_array(
+      std::move(std::get<varbor::Array>(array_copy.value())));
+    if (from_array.encode() != array_encoding) {
+        throw std::runtime_error("array built from Array");
+    }
+
+    // Popping back down through the levels
+    auto popped = array;
+    for (int i = 1100; i > 0; --i) {
+        if (popped.encode() != array_versions.back().push_back(varbor::Value(i - 1)).encode()) {
+            throw std::runtime_error("array pop");
+        }
+        popped = popped.pop_back();
+        array_versions.pop_back();
+    }
+    if (!popped.empty() || popped.encode() != varbor::Value(varbor::Array()).encode()) {
+        throw std::runtime_error("array pop to empty");
+    }
+    return 0;
+}
@@ -0,0 +1,135 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+
+#include <varbor.hxx>
+#include <varbor/instrument.hxx>
+#include <varbor/profile.hxx>
+
+#include <sstream>
+
+struct Ordered : varbor::DecodePolicy {
+    static constexpr bool preserve_map_order = true;
+    using instrument = varbor::Instrumented;
+};
+
+struct SmallInts : varbor::DecodePolicy {
+    static constexpr bool small_int_maps = true;
+    static constexpr bool allow_indefinite = false;
+};
+
+int main() {
+    const std::vector<std::byte> input{
+      // Header
+      std::byte(5 << 5) | std::byte(2),
+      // "items": [{"id": 1}, {"id": 2, 7: "x"}]
+      std::byte(3 << 5) | std::byte(5),
+      std::byte('i'),
+      std::byte('t'),
+      std::byte('e'),
+      std::byte('m'),
+      std::byte('s'),
+      std::byte(4 << 5) | std::byte(2),
+      std::byte(5 << 5) | std::byte(1),
+      std::byte(3 << 5) | std::byte(2),
+      std::byte('i'),
+      std::byte('d'),
+      std::byte(1),
+      std::byte(5 << 5) | std::byte(2),
+      std::byte(3 << 5) | std::byte(2),
+      std::byte('i'),
+      std::byte('d'),
+      std::byte(2),
+      std::byte(7),
+      std::byte(3 << 5) | std::byte(1),
+      std::byte('x'),
+      // h'00': null
+      std::byte(2 << 5) | std::byte(1),
+      std::byte(0),
+      std::byte(0xf6),
+    };
+
+    varbor::Profile profile;
+    const auto decoded = varbor::profile_decode(input, profile);
+    if (decoded != varbor::Value::decode(input)) {
+        throw std::runtime_error("profiled decode differs");
+    }
+
+    const auto &paths = profile.paths();
+    if (paths.size() != 6) {
+        throw std::runtime_error("path count");
+    }
+    if (paths.at("$").bytes != input.size() || paths.at("$").items != 1) {
+        throw std::runtime_error("root");
+    }
+    if (paths.at("$.items").bytes != 14 || paths.at("$.items[*]").items != 2) {
+        throw std::runtime_error("array");
+    }
+    if (paths.at("$.items[*].id").items != 2 || paths.at("$.items[*].id").bytes != 2) {
+        throw std::runtime_error("collapsed indices");
+    }
+    if (paths.at("$.items[*].7").bytes != 2 || paths.at("$.?").bytes != 1) {
+        throw std::runtime_error("non-text keys");
+    }
+    if (paths.at("$").time < paths.at("$.items").time) {
+        throw std::runtime_error("time is not inclusive");
+    }
+
+    const auto sorted = profile.sorted();
+    if (sorted.front().first != "$" || sorted[1].first != "$.items") {
+        throw std::runtime_error("sorted by size");
+    }
+
+    std::ostringstream report;
+    profile.report(report);
+    if (report.str().find("$.items[*].id\n") == std::string::npos) {
+        throw std::runtime_error("report");
+    }
+
+    // The CBOR form round trips
+    const auto exported = profile.to_value();
+    const auto &entry = exported[u8"$.items[*]"];
+    if (entry[u8"items"] != 2 || entry[u8"bytes"] != 13) {
+        throw std::runtime_error("to_value");
+    }
+    if (varbor::Value::decode(exported.encode()) != exported) {
+        throw std::runtime_error("to_value round trip");
+    }
+
+    // Profiling accumulates across decodes
+    varbor::profile_decode(input, profile);
+    if (profile.paths().at("$").items != 2) {
+        throw std::runtime_error("accumulate");
+    }
+
+    // Any policy decodes as it would unprofiled, and keeps its instrument
+    varbor::Profile ordered_profile;
+    varbor::Instrumented::take();
+    const auto ordered = varbor::profile_decode<Ordered>(input, ordered_profile);
+    const auto statistics = varbor::Instrumented::take();
+    if (ordered != varbor::Value::decode<Ordered>(input) ||
+        statistics.total_nodes() != varbor::Instrumented::take().total_nodes() ||
+        statistics.total_nodes() == 0 || ordered_profile.paths().size() != 6) {
+        throw std::runtime_error("ordered profile");
+    }
+    varbor::Profile small_profile;
+    if (varbor::profile_decode<SmallInts>(input, small_profile) !=
+          varbor::Value::decode<SmallInts>(input) ||
+        small_profile.paths().at("$.items[*].7").items != 1) {
+        throw std::runtime_error("small int profile");
+    }
+
+    // A failed decode leaves the next one unaffected
+    varbor::Profile failed;
+    try {
+        varbor::profile_decode(std::span(input).first(10), failed);
+        throw std::runtime_error("truncated input decoded");
+    } catch (const varbor::EndOfInput &) {
+    }
+    varbor::Profile after;
+    varbor::profile_decode(input, after);
+    if (after.paths().size() != 6 || after.paths().at("$").items != 1) {
+        throw std::runtime_error("profile after failure");
+    }
+    return 0;
+}
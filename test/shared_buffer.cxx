@@ -0,0 +1,100 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+
+#include <varbor.hxx>
+
+#include <cstring>
+#include <thread>
+
+int main() {
+    // {"key": [h'0102', 24(h'01')], 1: "text"}
+    varbor::Map map;
+    map.try_emplace(
+      u8"key",
+      varbor::Array::of(
+        std::vector<std::byte>{std::byte(1), std::byte(2)},
+        varbor::EmbeddedCbor::wrap(varbor::Value(1))));
+    map.try_emplace(1, u8"text");
+    const auto encoded = varbor::Value(std::move(map)).encode();
+
+    // Adopting a unique_ptr keeps its allocation
+    auto array = std::make_unique<std::byte[]>(encoded.size());
+    std::memcpy(array.get(), encoded.data(), encoded.size());
+    const auto data = array.get();
+    varbor::SharedBuffer adopted(std::move(array), encoded.size());
+    if (adopted.bytes().data() != data || adopted.use_count() != 1) {
+        throw std::runtime_error("unique_ptr adoption");
+    }
+
+    // A custom deleter runs once the last reference is gone
+    bool released = false;
+    auto value = [&] {
+        const auto frame = new std::byte[encoded.size()];
+        std::memcpy(frame, encoded.data(), encoded.size());
+        varbor::SharedBuffer buffer(frame, encoded.size(), [&released](const std::byte *bytes) {
+            released = true;
+            delete[] bytes;
+        });
+        auto decoded = varbor::Value::decode(buffer);
+        if (buffer.use_count() != 5) {
+            throw std::runtime_error("one reference per string");
+        }
+        return decoded;
+    }();
+    if (released) {
+        throw std::runtime_error("released under a live tree");
+    }
+
+    // Every string is a slice, map keys included
+    const auto &decoded = std::get<varbor::Map>(value.value());
+    const auto &key = std::get<varbor::Utf8String>(decoded.value.rbegin()->first->value());
+    const auto &items = std::get<varbor::Array>(decoded.value.rbegin()->second->value());
+    const auto &bytes = std::get<varbor::ByteString>(items.value[0]->value());
+    const auto &embedded = std::get<varbor::EmbeddedCbor>(items.value[1]->value());
+    if (key.value.index() != 2 || bytes.value.index() != 2 || embedded.bytes.value.index() != 2 ||
+        key.borrowed() || static_cast<std::u8string_view>(key) != u8"key") {
+        throw std::runtime_error("shared strings");
+    }
+
+    // own() leaves shared strings alone, since they are already safe
+    value.deep_own();
+    if (key.value.index() != 2) {
+        throw std::runtime_error("deep_own copied a shared string");
+    }
+
+    // The tree may finish its life on another thread
+    std::thread([tree = std::move(value), &encoded] {
+        if (tree.encode() != encoded) {
+            throw std::runtime_error("encoding");
+        }
+    }).join();
+    if (!released) {
+        throw std::runtime_error("leaked");
+    }
+
+    // Slices share storage, and are checked
+    const auto slice = adopted.slice(1, 4);
+    if (slice.bytes().data() != data + 1 || slice.size() != 4 || adopted.use_count() != 2) {
+        throw std::runtime_error("slice");
+    }
+    try {
+        static_cast<void>(adopted.slice(encoded.size(), 1));
+        throw std::runtime_error("slice past the end");
+    } catch (const std::out_of_range &) {
+    }
+    std::vector<std::byte> outside(encoded);
+    if (adopted.slice(std::span<const std::byte>(outside))) {
+        throw std::runtime_error("slice of foreign bytes");
+    }
+
+    // Vectors are taken over without a copy
+    std::vector<std::byte> owned(encoded);
+    const auto owned_data = owned.data();
+    const varbor::SharedBuffer from_vector(std::move(owned));
+    if (from_vector.bytes().data() != owned_data ||
+        varbor::Value::decode(from_vector).encode() != encoded) {
+        throw std::runtime_error("vector adoption");
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+
+#include <varbor.hxx>
+#include <varbor/instrument.hxx>
+
+#include <random>
+
+struct Counted : varbor::DecodePolicy {
+    using instrument = varbor::Instrumented;
+};
+
+struct KeepLast : varbor::DecodePolicy {
+    static constexpr varbor::DuplicateKeys duplicate_keys = varbor::DuplicateKeys::KeepLast;
+};
+
+static std::pair<varbor::ValuePointer, varbor::ValuePointer> entry(
+  const int key,
+  const int value) {
+    return {std::make_unique<varbor::Value>(key), std::make_unique<varbor::Value>(value)};
+}
+
+static std::vector<std::byte> encode(const varbor::Map &map) {
+    std::vector<std::byte> output;
+    map.encode(std::back_inserter(output));
+    return output;
+}
+
+int main() {
+    std::mt19937 random(11);
+
+    // Sorted, unsorted and repeated entries all build the same map as inserting
+    std::vector<std::pair<varbor::ValuePointer, varbor::ValuePointer>> entries;
+    varbor::Map reference;
+    for (int i = 0; i < 300; ++i) {
+        // Mostly ascending, with some stragglers and repeats
+        const int key = random() % 8 == 0 ? static_cast<int>(random() % 300) : i;
+        entries.push_back(entry(key, i));
+        reference.value.insert_or_assign(
+          std::make_unique<varbor::Value>(key),
+          std::make_unique<varbor::Value>(i));
+    }
+    const auto built = varbor::Map::from_sorted(std::move(entries));
+    if (built != reference) {
+        throw std::runtime_error("from_sorted");
+    }
+
+    varbor::Map appended;
+    const auto append = [&appended](const int key, const int value) {
+        auto [k, v] = entry(key, value);
+        return appended.append(std::move(k), std::move(v));
+    };
+    if (!append(2, 0) || !append(5, 1) || !append(3, 2) || append(5, 3) || append(3, 4)) {
+        throw std::runtime_error("append result");
+    }
+    if (appended.value.size() != 3 ||
+        *appended.value.find(varbor::Value(5))->second != varbor::Value(3) ||
+        *appended.value.find(varbor::Value(3))->second != varbor::Value(4)) {
+        throw std::runtime_error("append");
+    }
+
+    // Merging overlapping maps keeps the last map's value for shared keys
+    std::vector<varbor::Map> maps(4);
+    varbor::Map merged_reference;
+    for (std::size_t m = 0; m < maps.size(); ++m) {
+        for (int i = 0; i < 100; ++i) {
+            const int key = static_cast<int>(random() % 200);
+            const int value = static_cast<int>(m * 1000) + i;
+            maps[m].value.insert_or_assign(
+              std::make_unique<varbor::Value>(key),
+              std::make_unique<varbor::Value>(value));
+            merged_reference.value.insert_or_assign(
+              std::make_unique<varbor::Value>(key),
+              std::make_unique<varbor::Value>(value));
+        }
+    }
+    maps.emplace_back();
+    const auto merged = varbor::Map::merge(std::move(maps));
+    if (merged != merged_reference || encode(merged) != encode(merged_reference)) {
+        throw std::runtime_error("merge");
+    }
+    if (!varbor::Map::merge({}).value.empty()) {
+        throw std::runtime_error("empty merge");
+    }
+
+    // Decoding a map in key order costs one comparison per key after the first
+    const auto sorted_input = encode(merged_reference);
+    varbor::Instrumented::take();
+    const auto decoded = varbor::Value::decode<Counted>(sorted_input);
+    const auto statistics = varbor::Instrumented::take();
+    if (statistics.map_comparisons != merged_reference.value.size() - 1) {
+        throw std::runtime_error("sorted decode comparisons");
+    }
+    if (decoded.encode() != sorted_input) {
+        throw std::runtime_error("sorted decode");
+    }
+
+    // Out of order and duplicate keys on the wire still decode correctly
+    const std::vector<std::byte> unsorted{
+      std::byte(5 << 5) | std::byte(4),
+      std::byte(3),
+      std::byte(0),
+      std::byte(1),
+      std::byte(1),
+      std::byte(2),
+      std::byte(2),
+      std::byte(1),
+      std::byte(3),
+    };
+    const auto unsorted_decoded = varbor::Value::decode<KeepLast>(unsorted);
+    const auto &unsorted_map = std::get<varbor::Map>(unsorted_decoded.value());
+    if (unsorted_map.value.size() != 3 ||
+        *unsorted_map.value.find(varbor::Value(1))->second != varbor::Value(3) ||
+        unsorted_map.value.begin()->first != varbor::Value(1)) {
+        throw std::runtime_error("unsorted decode");
+    }
+
+    // Maps with the default comparator are still accepted
+    std::map<varbor::ValuePointer, varbor::ValuePointer> plain;
+    plain.emplace(std::make_unique<varbor::Value>(2), std::make_unique<varbor::Value>(u8"b"));
+    plain.emplace(std::make_unique<varbor::Value>(1), std::make_unique<varbor::Value>(u8"a"));
+    const varbor::Map adopted(std::move(plain));
+    if (adopted.value.size() != 2 || adopted.value.begin()->first != varbor::Value(1)) {
+        throw std::runtime_error("default comparator map");
+    }
+    return 0;
+}
@@ -0,0 +1,220 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+
+#include <varbor.hxx>
+#include <varbor/tags.hxx>
+
+struct Typed : varbor::DecodePolicy {
+    using tags = varbor::StandardTags;
+};
+
+/** Decode with the standard tags, check the node type, and check that it
+ * encodes back to the same bytes.
+ */
+template <typename T>
+T round_trip(const std::vector<std::byte> &input) {
+    const auto value = varbor::Value::decode<Typed>(input);
+    const auto node = std::get_if<T>(&value.value());
+    if (!node) {
+        throw std::runtime_error("wrong node type");
+    }
+    if (value.encode() != input) {
+        throw std::runtime_error("encoding does not mirror decoding");
+    }
+    return *node;
+}
+
+/** Decode with the standard tags, check that it stays generic, and check that
+ * it encodes back to the same bytes.
+ */
+void stays_generic(const std::vector<std::byte> &input, const char *const what) {
+    const auto value = varbor::Value::decode<Typed>(input);
+    if (!std::holds_alternative<varbor::SemanticTag>(value.value()) || value.encode() != input) {
+        throw std::runtime_error(what);
+    }
+}
+
+std::vector<std::byte> tagged_string(const std::uint8_t tag, const std::string_view string) {
+    std::vector<std::byte> output{std::byte(6 << 5) | std::byte(tag)};
+    if (string.size() < 24) {
+        output.push_back(std::byte(3 << 5) | std::byte(string.size()));
+    } else {
+        output.push_back(std::byte(3 << 5) | std::byte(24));
+        output.push_back(std::byte(string.size()));
+    }
+    for (const auto c : string) {
+        output.push_back(std::byte(c));
+    }
+    return output;
+}
+
+int main() {
+    using namespace std::chrono;
+
+    // Tag 0
+    const auto utc = round_trip<varbor::DateTime>(tagged_string(0, "2013-03-21T20:04:00Z"));
+    if (utc.time() != sys_days(2013y / March / 21) + 20h + 4min) {
+        throw std::runtime_error("tag 0 time");
+    }
+    const auto offset =
+      round_trip<varbor::DateTime>(tagged_string(0, "1996-12-19T16:39:57.25-08:00"));
+    if (
+      offset.time() != sys_days(1996y / December / 20) + 39min + 57s + 250ms ||
+      offset.offset() != -8h) {
+        throw std::runtime_error("tag 0 offset");
+    }
+
+    // Tag 1, integral and fractional
+    const auto epoch = round_trip<varbor::DateTime>(
+      {std::byte(0xc1),
+       std::byte(0x1a),
+       std::byte(0x51),
+       std::byte(0x4b),
+       std::byte(0x67),
+       std::byte(0xb0)});
+    if (epoch.time() != sys_days(2013y / March / 21) + 20h + 4min) {
+        throw std::runtime_error("tag 1 time");
+    }
+    const auto fractional = round_trip<varbor::DateTime>(
+      {std::byte(0xc1), std::byte(0xf9), std::byte(0x3e), std::byte(0x00)});
+    if (fractional.time().time_since_epoch() != 1500ms) {
+        throw std::runtime_error("tag 1 fractional time");
+    }
+
+    // Tags 2 and 3
+    std::vector<std::byte> bignum{std::byte(0xc2), std::byte(0x49)};
+    for (int i = 0; i < 9; ++i) {
+        bignum.push_back(std::byte(i + 1));
+    }
+    const auto big = round_trip<varbor::BigNum>(bignum);
+    if (big.negative || big.high != 0x01 || big.low != 0x0203040506070809ull) {
+        throw std::runtime_error("bignum");
+    }
+#ifdef VARBOR_HAS_INT128
+    if (big.to_int128() != (static_cast<varbor::Int128>(1) << 64) + 0x0203040506070809ll) {
+        throw std::runtime_error("bignum int128");
+    }
+    const auto negative = round_trip<varbor::BigNum>(
+      {std::byte(0xc3), std::byte(0x42), std::byte(0x01), std::byte(0x00)});
+    if (negative.to_int128() != -257) {
+        throw std::runtime_error("negative bignum");
+    }
+#endif
+
+    // Tag 4: 273.15
+    const auto decimal = round_trip<varbor::DecimalFraction>(
+      {std::byte(0xc4),
+       std::byte(0x82),
+       std::byte(0x21),
+       std::byte(0x19),
+       std::byte(0x6a),
+       std::byte(0xb3)});
+    if (decimal.exponent != -2 || decimal.mantissa != 27315) {
+        throw std::runtime_error("decimal fraction");
+    }
+
+    // Tag 37
+    std::vector<std::byte> uuid{std::byte(0xd8), std::byte(37), std::byte(0x50)};
+    for (int i = 0; i < 16; ++i) {
+        uuid.push_back(std::byte(0xa0 + i));
+    }
+    if (round_trip<varbor::Uuid>(uuid).bytes[15] != std::byte(0xaf)) {
+        throw std::runtime_error("uuid");
+    }
+
+    // Tag 24
+    const auto embedded = round_trip<varbor::EmbeddedCbor>(
+      {std::byte(0xd8), std::byte(24), std::byte(0x42), std::byte(0x18), std::byte(0x64)});
+    const std::span<const std::byte> inner = embedded.bytes;
+    if (varbor::Value::decode(inner) != varbor::Value(100)) {
+        throw std::runtime_error("embedded cbor");
+    }
+
+    // Unparseable payloads and unknown tags stay generic
+    if (!std::holds_alternative<varbor::SemanticTag>(
+          varbor::Value::decode<Typed>(tagged_string(0, "yesterday")).value())) {
+        throw std::runtime_error("bad date");
+    }
+    if (!std::holds_alternative<varbor::SemanticTag>(
+          varbor::Value::decode<Typed>(tagged_string(9, "x")).value())) {
+        throw std::runtime_error("unknown tag");
+    }
+    // As do payloads the typed node would not encode back to exactly
+    stays_generic(tagged_string(0, "2016-12-31T23:59:60Z"), "leap second");
+    stays_generic(tagged_string(0, "2013-03-21T20:04:00+24:00"), "offset hours");
+    stays_generic(tagged_string(0, "2013-03-21T20:04:00-08:60"), "offset minutes");
+    stays_generic(tagged_string(0, "2013-03-21t20:04:00z"), "lowercase date");
+    stays_generic(tagged_string(0, "2013-03-21T20:04:00+00:00"), "zero offset");
+    stays_generic(tagged_string(0, "2013-03-21T20:04:00.500Z"), "trailing zeros");
+    stays_generic(tagged_string(0, "0000-01-01T00:00:00Z"), "year 0000");
+    stays_generic(tagged_string(0, "9999-12-31T23:59:59Z"), "year 9999");
+    stays_generic(tagged_string(0, "2262-04-11T23:00:00-01:00"), "range after offset");
+    // 2.0, a whole second, would encode as an integer
+    stays_generic({std::byte(0xc1), std::byte(0xf9), std::byte(0x40), std::byte(0x00)}, "whole");
+    // 1.5000000001, finer than a nanosecond
+    std::vector<std::byte> fine{std::byte(0xc1), std::byte(0xfb)};
+    for (const auto byte : {0x3f, 0xf8, 0x00, 0x00, 0x00, 0x06, 0xdf, 0x38}) {
+        fine.push_back(std::byte(byte));
+    }
+    stays_generic(fine, "sub-nanosecond");
+    stays_generic({std::byte(0xc2), std::byte(0x42), std::byte(0x00), std::byte(0x01)}, "zeros");
+    const auto zero = round_trip<varbor::BigNum>({std::byte(0xc2), std::byte(0x40)});
+    if (zero.negative || zero.high != 0 || zero.low != 0) {
+        throw std::runtime_error("empty bignum");
+    }
+
+    // Typed nodes equal their generic form, and sort among tags by encoding
+    const std::vector<std::vector<std::byte>> tagged{
+      tagged_string(0, "2013-03-21T20:04:00Z"),
+      {std::byte(0xc1), std::byte(0x20)},
+      {std::byte(0xc3), std::byte(0x42), std::byte(0x01), std::byte(0x00)},
+      {std::byte(0xc4),
+       std::byte(0x82),
+       std::byte(0x21),
+       std::byte(0x19),
+       std::byte(0x6a),
+       std::byte(0xb3)},
+      uuid,
+      {std::byte(0xd8), std::byte(24), std::byte(0x42), std::byte(0x18), std::byte(0x64)},
+    };
+    for (const auto &input : tagged) {
+        const auto typed = varbor::Value::decode<Typed>(input);
+        const auto generic = varbor::Value::decode(input);
+        if (typed != generic || (typed <=> generic) != 0 || typed.hash() != generic.hash()) {
+            throw std::runtime_error("typed equals generic");
+        }
+        if (!(typed > varbor::Value(varbor::Map{})) || !(typed < varbor::Value(true))) {
+            throw std::runtime_error("typed sorts as a tag");
+        }
+        for (const auto &other : tagged) {
+            const auto order = std::lexicographical_compare_three_way(
+              input.begin(), input.end(), other.begin(), other.end());
+            if ((typed <=> varbor::Value::decode<Typed>(other)) != order ||
+                (typed <=> varbor::Value::decode(other)) != order) {
+                throw std::runtime_error("typed orders by encoding");
+            }
+        }
+    }
+
+    // So a map keyed by typed nodes round trips in canonical order
+    std::vector<std::byte> keyed{std::byte(5 << 5) | std::byte(2)};
+    keyed.insert(keyed.end(), uuid.begin(), uuid.end());
+    keyed.push_back(std::byte(1));
+    keyed.push_back(std::byte(0xf5));
+    keyed.push_back(std::byte(2));
+    if (varbor::Value::decode<Typed>(keyed).encode() != keyed) {
+        throw std::runtime_error("typed key order");
+    }
+    varbor::Map times;
+    times.try_emplace(varbor::Value::decode<Typed>(tagged[0]), varbor::Value(0));
+    if (times.try_emplace(varbor::Value::decode(tagged[0]), varbor::Value(1)).second) {
+        throw std::runtime_error("duplicate typed key");
+    }
+
+    // And the default policy decodes no tags
+    if (!std::holds_alternative<varbor::SemanticTag>(varbor::Value::decode(uuid).value())) {
+        throw std::runtime_error("default policy");
+    }
+    return 0;
+}
@@ -0,0 +1,71 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+
+#include <varbor.hxx>
+
+struct Borrowing : varbor::DecodePolicy {
+    static constexpr bool borrow_strings = true;
+};
+
+// Views of temporaries are rejected at compile time.
+template <typename T>
+concept Viewable = requires(T &&t) { varbor::Value::view(std::forward<T>(t)); };
+static_assert(Viewable<std::vector<std::byte> &>);
+static_assert(Viewable<std::u8string &>);
+static_assert(Viewable<const char8_t *>);
+static_assert(!Viewable<std::vector<std::byte>>);
+static_assert(!Viewable<std::u8string>);
+
+int main() {
+    std::vector<std::byte> bytes{std::byte(1), std::byte(2), std::byte(3)};
+    std::u8string text(u8"a string long enough to skip small string storage");
+
+    // Views point at the caller's storage, and encode like copies
+    const auto byte_view = varbor::Value::view(bytes);
+    const auto &byte_string = std::get<varbor::ByteString>(byte_view.value());
+    if (!byte_string.borrowed() ||
+        static_cast<std::span<const std::byte>>(byte_string).data() != bytes.data()) {
+        throw std::runtime_error("byte view");
+    }
+    const auto text_view = varbor::Value::view(text);
+    const auto &utf8_string = std::get<varbor::Utf8String>(text_view.value());
+    if (!utf8_string.borrowed() ||
+        static_cast<std::u8string_view>(utf8_string).data() != text.data()) {
+        throw std::runtime_error("text view");
+    }
+    if (byte_view.encode() != varbor::Value(bytes).encode() ||
+        text_view.encode() != varbor::Value(text).encode() ||
+        byte_view != varbor::Value(bytes)) {
+        throw std::runtime_error("view encoding");
+    }
+
+    // deep_own detaches a whole tree, keys included
+    varbor::Map map;
+    map.try_emplace(varbor::Value::view(text), varbor::Array::of(varbor::Value::view(bytes)));
+    map.try_emplace(
+      1,
+      varbor::SemanticTag(7, std::make_unique<varbor::Value>(varbor::Value::view(u8"tagged"))));
+    varbor::Value tree(std::move(map));
+    const auto before = tree.encode();
+    tree.deep_own();
+    bytes.assign(3, std::byte(0));
+    text.assign(text.size(), u8'x');
+    if (tree.encode() != before) {
+        throw std::runtime_error("deep_own");
+    }
+    const auto &owned = std::get<varbor::Map>(tree.value());
+    if (std::get<varbor::Utf8String>(owned.value.rbegin()->first->value()).borrowed()) {
+        throw std::runtime_error("key still borrowed");
+    }
+
+    // And outlives the input of a borrowing decode
+    auto input = before;
+    auto decoded = varbor::Value::decode<Borrowing>(input);
+    decoded.deep_own();
+    input.assign(input.size(), std::byte(0));
+    if (decoded.encode() != before) {
+        throw std::runtime_error("decoded deep_own");
+    }
+    return 0;
+}
@@ -0,0 +1,292 @@
+/* Copyright © 2022 Taylor C. Richberger
+ * This code is released under the license described in the LICENSE file
+ */
+
+#include <varbor.hxx>
+#include <varbor/parallel.hxx>
+#include <varbor/walk.hxx>
+
+#include <random>
+
+struct SmallIntMaps : varbor::DecodePolicy {
+    static constexpr bool small_int_maps = true;
+};
+
+// Follow path down from root, the way the walk came.
+static const varbor::Value &follow(const varbor::Value &root, std::span<const varbor::Step> path) {
+    const varbor::Value *node = &root;
+    for (const auto &step : path) {
+        const auto &variant = node->value();
+        if (const auto array = std::get_if<varbor::Array>(&variant)) {
+            node = &*array->value.at(step.index);
+        } else if (const auto map = std::get_if<varbor::Map>(&variant)) {
+            node = &*map->value.find(*step.key)->second;
+        } else if (const auto int_map = std::get_if<varbor::IntMap>(&variant)) {
+            node = int_map->find(*step.key);
+        } else {
+            node = &*std::get<varbor::SemanticTag>(variant).value;
+        }
+        if (!node) {
+            throw std::runtime_error("path leads nowhere");
+        }
+    }
+    return *node;
+}
+
+// A random tree of arrays and maps with integer leaves.
+static varbor::Value tree(std::mt19937 &random, const int depth) {
+    if (depth == 0 || random() % 4 == 0) {
+        return varbor::Value(static_cast<int>(random() % 1000));
+    }
+    const auto size = random() % 12;
+    if (random() % 2 == 0) {
+        varbor::Array array;
+        for (std::size_t i = 0; i < size; ++i) {
+            array.value.push_back(std::make_unique<varbor::Value>(tree(random, depth - 1)));
+        }
+        return varbor::Value(std::move(array));
+    }
+    varbor::Map map;
+    for (std::size_t i = 0; i < size; ++i) {
+        map.value.insert_or_assign(
+          std::make_unique<varbor::Value>(static_cast<int>(random() % 100)),
+          std::make_unique<varbor::Value>(tree(random, depth - 1)));
+    }
+    return varbor::Value(std::move(map));
+}
+
+struct Totals {
+    std::size_t nodes = 0;
+    std::size_t positives = 0;
+    std::uint64_t sum = 0;
+};
+
+int main() {
+    // {"a": [1, 2(h'')], "b": {1: null}}
+    const std::vector<std::byte> input{
+      std::byte(5 << 5) | std::byte(2),
+      std::byte(3 << 5) | std::byte(1),
+      std::byte('a'),
+      std::byte(4 << 5) | std::byte(2),
+      std::byte(1),
+      std::byte(6 << 5) | std::byte(2),
+      std::byte(2 << 5),
+      std::byte(3 << 5) | std::byte(1),
+      std::byte('b'),
+      std::byte(5 << 5) | std::byte(1),
+      std::byte(1),
+      std::byte(0xf6),
+    };
+    const auto document = varbor::Value::decode<SmallIntMaps>(input);
+
+    // Pre and post order, with depths
+    using Event = varbor::Cursor::Event;
+    std::vector<std::pair<Event, std::size_t>> events;
+    varbor::Cursor cursor(document);
+    do {
+        events.emplace_back(cursor.event(), cursor.depth());
+        if (&follow(document, cursor.path()) != &cursor.value()) {
+            throw std::runtime_error("path");
+        }
+    } while (cursor.next());
+    const std::vector<std::pair<Event, std::size_t>> expected{
+      {Event::Enter, 0},
+      {Event::Enter, 1},
+      {Event::Enter, 2},
+      {Event::Leave, 2},
+      {Event::Enter, 2},
+      {Event::Enter, 3},
+      {Event::Leave, 3},
+      {Event::Leave, 2},
+      {Event::Leave, 1},
+      {Event::Enter, 1},
+      {Event::Enter, 2},
+      {Event::Leave, 2},
+      {Event::Leave, 1},
+      {Event::Leave, 0},
+    };
+    if (events != expected || cursor.next()) {
+        throw std::runtime_error("events");
+    }
+
+    // Skipping children, and paths under a prefix
+    const std::vector<varbor::Step> prefix{{3, nullptr}};
+    varbor::Cursor skipping(document, prefix);
+    std::size_t entered = 0;
+    do {
+        if (skipping.event() == Event::Enter) {
+            ++entered;
+            if (skipping.path().size() != skipping.depth() + 1 || skipping.path()[0] != prefix[0]) {
+                throw std::runtime_error("prefix");
+            }
+            if (skipping.depth() == 1) {
+                skipping.skip();
+            }
+        }
+    } while (skipping.next());
+    if (entered != 3) {
+        throw std::runtime_error("skip");
+    }
+
+    // Deep nesting does not recurse
+    varbor::Value deep(0);
+    for (int i = 0; i < 2000; ++i) {
+        varbor::Array array;
+        array.value.push_back(std::make_unique<varbor::Value>(std::move(deep)));
+        deep = varbor::Value(std::move(array));
+    }
+    std::size_t deepest = 0;
+    for (varbor::Cursor walk(deep); walk.next();) {
+        deepest = std::max(deepest, walk.depth());
+    }
+    if (deepest != 2000) {
+        throw std::runtime_error("deep");
+    }
+
+    // Mutable cursors can rewrite nodes on the way down
+    std::mt19937 random(3);
+    auto root = tree(random, 6);
+    Totals before;
+    varbor::MutableCursor rewriting(root);
+    do {
+        if (rewriting.event() == Event::Enter) {
+            ++before.nodes;
+            if (const auto positive = std::get_if<varbor::Positive>(&rewriting.value().value())) {
+                ++before.positives;
+                before.sum += positive->value;
+                rewriting.value() = varbor::Value(positive->value + 1);
+            }
+        }
+    } while (rewriting.next());
+
+    // The parallel visitor sees every node once, with its full path
+    const auto reduce = [](Totals &into, Totals &&from) {
+        into.nodes += from.nodes;
+        into.positives += from.positives;
+        into.sum += from.sum;
+    };
+    const auto count = [&root](
+                         const varbor::Value &node,
+                         const std::span<const varbor::Step> path,
+                         Totals &totals) {
+        if (&follow(root, path) != &node) {
+            throw std::runtime_error("parallel path");
+        }
+        ++totals.nodes;
+        if (const auto positive = std::get_if<varbor::Positive>(&node.value())) {
+            ++totals.positives;
+            totals.sum += positive->value;
+        }
+    };
+    for (const std::size_t threads : {0, 1, 2, 4, 16}) {
+        const auto totals =
+          varbor::parallel_reduce(std::as_const(root), Totals{}, count, reduce, threads, 2);
+        if (totals.nodes != before.nodes || totals.positives != before.positives ||
+            totals.sum != before.sum + before.positives) {
+            throw std::runtime_error("parallel totals");
+        }
+    }
+
+    // And can rewrite them in parallel too
+    const auto undo = [](varbor::Value &node, std::span<const varbor::Step>, Totals &totals) {
+        if (const auto positive = std::get_if<varbor::Positive>(&node.value())) {
+            ++totals.positives;
+            node = varbor::Value(positive->value - 1);
+        }
+    };
+    if (varbor::parallel_reduce(root, Totals{}, undo, reduce, 4, 2).positives != before.positives ||
+        varbor::parallel_reduce(std::as_const(root), Totals{}, count, reduce).sum != before.sum) {
+        throw std::runtime_error("parallel rewrite");
+    }
+
+    // Runs of children, walked by cursors of their own, cover every child
+    varbor::Map wide_map;
+    for (int i = 0; i < 1000; ++i) {
+        wide_map.try_emplace(i, varbor::Array::of(i, -i));
+    }
+    varbor::IntMap wide_int_map;
+    for (int i = -24; i < 200; i += 3) {
+        wide_int_map.insert(varbor::Value(i), varbor::Value(i));
+    }
+    varbor::Array wide_array;
+    for (int i = 0; i < 5000; ++i) {
+        wide_array.emplace_back(i);
+    }
+    const varbor::Value wide(varbor::Array::of(
+      std::move(wide_array),
+      std::move(wide_map),
+      std::move(wide_int_map)));
+    for (const auto &child : std::get<varbor::Array>(wide.value()).value) {
+        std::vector<const varbor::Value *> expected_children;
+        varbor::Cursor whole(*child);
+        while (whole.next() && whole.depth() == 1) {
+            expected_children.push_back(&whole.value());
+            whole.skip();
+            whole.next();
+        }
+        std::vector<const varbor::Value *> children;
+        for (const auto &range : varbor::Cursor::split(*child, 7)) {
+            varbor::Cursor run(range, {});
+            do {
+                if (run.event() == Event::Enter && run.depth() == 1) {
+                    if (&follow(*child, run.path()) != &run.value()) {
+                        throw std::runtime_error("run path");
+                    }
+                    children.push_back(&run.value());
+                }
+            } while (run.next());
+        }
+        if (children != expected_children ||
+            children.size() != varbor::Cursor::children(*child)) {
+            throw std::runtime_error("runs");
+        }
+    }
+
+    // Wide containers are split into runs for the threads
+    const auto count_wide = [&wide](
+                              const varbor::Value &node,
+                              const std::span<const varbor::Step> path,
+                              std::size_t &nodes) {
+        if (&follow(wide, path) != &node) {
+            throw std::runtime_error("wide path");
+        }
+        ++nodes;
+    };
+    const auto add_nodes = [](std::size_t &into, std::size_t &&from) {
+        into += from;
+    };
+    std::size_t wide_nodes = 0;
+    for (varbor::Cursor walk(wide); walk.next();) {
+        wide_nodes += walk.event() == Event::Enter;
+    }
+    ++wide_nodes;
+    for (const std::size_t threads : {1, 2, 4}) {
+        if (varbor::parallel_reduce(wide, std::size_t(0), count_wide, add_nodes, threads, 2) !=
+              wide_nodes ||
+            varbor::parallel_reduce(
+              *std::get<varbor::Array>(wide.value()).value[0],
+              std::size_t(0),
+              [](const varbor::Value &, std::span<const varbor::Step>, std::size_t &nodes) {
+                  ++nodes;
+              },
+              add_nodes,
+              threads) != 5001) {
+            throw std::runtime_error("wide parallel totals");
+        }
+    }
+
+    // init is counted once, however many threads there are
+    const auto add = [](std::size_t &into, std::size_t &&from) {
+        into += from;
+    };
+    const auto one = [](const varbor::Value &, std::span<const varbor::Step>, std::size_t &count) {
+        ++count;
+    };
+    for (const std::size_t threads : {1, 4}) {
+        if (varbor::parallel_reduce(std::as_const(root), std::size_t(10), one, add, threads, 2) !=
+            before.nodes + 10) {
+            throw std::runtime_error("parallel init");
+        }
+    }
+    return 0;
+}